@@ -7,6 +7,7 @@ CDEBUG="-O0 -ggdb -fsanitize=address -fno-omit-frame-pointer"
 CPROFILE="-pg"
 CRELEASE="-O3 -march=native"
 CC="clang"
+CXX="clang++"
 
 OUTDIR="./out"
 VERBOSE=true
@@ -81,8 +82,16 @@ else
   CFLAGS="$CFLAGS $CRELEASE"
 fi
 
+GEN="./gen.sh examples/generated/schema.h app app examples/generated/app_gen.h"
+
+if $VERBOSE; then
+  echo + $GEN
+fi
+
+CC="$CC" $GEN
+
 tests=$(find ./tests -name '*.c')
-examples=$(find ./examples -name '*.c')
+examples=$(find ./examples -maxdepth 1 -name '*.c')
 
 for example in $examples; do
   CMD="$CC $CFLAGS $CLIBS -o $OUTDIR/$(basename ${example%.*}) $example"
@@ -96,8 +105,20 @@ for example in $examples; do
   fi
 done
 
+# C++ front-end example, C implementation lives in its own translation unit
+CMD="$CC $CFLAGS $CLIBS -c -o $OUTDIR/cpp_optly.o examples/cpp/optly.c"
+CXXCMD="$CXX ${CFLAGS/-std=c99/-std=c++20} $CLIBS -o $OUTDIR/cpp examples/cpp/main.cpp $OUTDIR/cpp_optly.o"
+
+if $VERBOSE; then
+  echo + $CMD
+  echo + $CXXCMD
+fi
+
+$CMD
+$CXXCMD
+
 if $VERBOSE; then
   set -x
 fi
 
-$CC  $CFLAGS $CSTD $CLIBS -o "$OUTDIR/tests" $tests
+$CC  $CFLAGS $CSTD $CLIBS -pthread -o "$OUTDIR/tests" $tests
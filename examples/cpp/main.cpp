@@ -0,0 +1,51 @@
+#include <cstdio>
+
+// Must match defines of optly.c
+#define OPTLY_GEN_HELP_FLAG
+#define OPTLY_GEN_HELP_COMMAND
+#include <optly.hpp>
+
+using app = optly::command<"app", "C++ front-end example",
+  optly::flags<
+    optly::flag<"verbose", OPTLY_TYPE_BOOL, 'v', "Enable verbose output">,
+    optly::flag<"threads", OPTLY_TYPE_UINT32, 't', "Worker threads", 4>,
+    optly::flag<"timeout", OPTLY_TYPE_DURATION, 0, "Request timeout", 30'000'000'000>
+  >,
+  optly::commands<
+    optly::command<"run", "Runs server",
+      optly::flags<
+        optly::flag<"port", OPTLY_TYPE_UINT16, 'p', "Server port", 8080>,
+        optly::flag<"host", OPTLY_TYPE_STRING, 0, "Address to listen on", optly::name("0.0.0.0")>
+      >,
+      optly::commands<>,
+      optly::positionals<optly::positional<"files", "Files to serve", 0, 0>>
+    >
+  >
+>;
+
+int main(int argc, char **argv) {
+  static char        buf[1 << 16];
+  optly::result<app> res(buf, sizeof(buf));
+
+  if (!res.parse(argc, argv)) {
+    optly_error_print(&res.errors());
+    return 1;
+  }
+
+  // Names are checked while compiling: get<"thread">() or get<"threads", int>() don't build
+  std::printf("verbose = %s\n", res.get<"verbose">() ? "true" : "false");
+  std::printf("threads = %u\n", res.get<"threads", uint32_t>());
+  std::printf("timeout = %lldns\n", static_cast<long long>(res.get<"timeout">()));
+
+  if (auto run = res.command<"run">()) {
+    std::printf("run on %s:%u\n", run.get<"host">(), run.get<"port">());
+
+    const OptlyValues &files = run.positional<"files">();
+
+    for (std::size_t i = 0; i < files.count; i++) {
+      std::printf("file: %s\n", files.items[i]);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,6 @@
+// C implementation for main.cpp, optly.hpp only wraps it
+
+#define OPTLY_GEN_HELP_FLAG
+#define OPTLY_GEN_HELP_COMMAND
+#define OPTLY_IMPLEMENTATION
+#include <optly.h>
@@ -21,7 +21,7 @@ int main(int argc, char **argv) {
 
         // Values are unions, so you need to specify member of value with
         // correct type some way
-        {"threads", 't', "Worker threads", false, false, {.as_uint32 = 4}, OPTLY_TYPE_UINT32},
+        {"threads", 't', "Worker threads", .value.as_uint32 = 4, .type = OPTLY_TYPE_UINT32},
 
         // Flag arrays should alwasy ends with NULL_FLAG. Try to not forget
         // about it :)
@@ -109,15 +109,21 @@ void services(OptlyCommand *cmd) {
 }
 
 int main(int argc, char *argv[]) {
+  bool  verbose = false;
+  char *config  = "./config";
+  char *env     = "dev";
+  bool  json    = false;
+
+  // NOTE: Global flags are bound to local variables, parser writes values straight into them
   OptlyCommand cmd = optly_command(
     "full.c",
     "Full example of optly usage",
 
     optly_flags(
-      optly_flag_bool("verbose", 'b', "Enable verbose logging"),
-      optly_flag_string("config", 'c', "Config file path", .value.as_string = "./config"),
-      optly_flag_string("env", 'e', "Environment (dev, staging, prod)", .value.as_string = "dev"),
-      optly_flag_bool("json", 'j', "Output JSON")
+      optly_flag_bool("verbose", 'b', "Enable verbose logging", .bind.as_bool = &verbose),
+      optly_flag_string("config", 'c', "Config file path", .value.as_string = "./config", .bind.as_string = &config),
+      optly_flag_string("env", 'e', "Environment (dev, staging, prod)", .value.as_string = "dev", .bind.as_string = &env),
+      optly_flag_bool("json", 'j', "Output JSON", .bind.as_bool = &json)
     ),
 
     optly_commands(
@@ -197,10 +203,10 @@ int main(int argc, char *argv[]) {
   optly_parse_args(argc, argv, &cmd, "v1.0.0");
 
   printf("Global flags:\n");
-  printf("verbose = %s\n", optly_flag_value_bool(&cmd, "verbose") ? "true" : "false");
-  printf("config  = %s\n", optly_flag_value_string(&cmd, "config"));
-  printf("env     = %s\n", optly_flag_value_string(&cmd, "env"));
-  printf("json    = %s\n", optly_flag_value_bool(&cmd, "json") ? "true" : "false");
+  printf("verbose = %s\n", verbose ? "true" : "false");
+  printf("config  = %s\n", config);
+  printf("env     = %s\n", env);
+  printf("json    = %s\n", json ? "true" : "false");
   printf("\n");
 
   if (optly_is_command(cmd.next_command, "build")) {
@@ -0,0 +1,30 @@
+#include <stdio.h>
+
+#define OPTLY_IMPLEMENTATION
+#include "generated/schema.h"
+
+// Made by `./gen.sh examples/generated/schema.h app app examples/generated/app_gen.h`
+#include "generated/app_gen.h"
+
+int main(int argc, char **argv) {
+  // Flag and command lookups go through generated matchers, help is printed from precomputed text
+  if (!app_install(&app)) {
+    return 1;
+  }
+
+  optly_parse_args(argc, argv, &app);
+
+  printf("Verbose: %s\n", app.bools[APP_VERBOSE_WORD] & APP_VERBOSE_BIT ? "true" : "false");
+  printf("Threads: %u\n", app.flags[APP_THREADS].value.as_uint32);
+
+  if (optly_is_command(app.next_command, "serve")) {
+    OptlyCommand *serve = app.next_command;
+
+    printf("Listening on %s:%u%s\n", serve->flags[APP_SERVE_HOST].value.as_string, serve->flags[APP_SERVE_PORT].value.as_uint16,
+           serve->bools[APP_SERVE_TLS_WORD] & APP_SERVE_TLS_BIT ? " with TLS" : "");
+  } else if (optly_is_command(app.next_command, "check")) {
+    printf("Strict: %s\n", app.next_command->bools[APP_CHECK_STRICT_WORD] & APP_CHECK_STRICT_BIT ? "true" : "false");
+  }
+
+  return 0;
+}
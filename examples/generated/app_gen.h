@@ -0,0 +1,206 @@
+// Generated by optly_generate, do not edit.
+// Include after optly.h and call app_install on the schema it was generated from.
+
+#include <string.h>
+
+// app
+
+enum {
+  APP_VERBOSE = 0,
+  APP_THREADS = 1,
+};
+
+#define APP_VERBOSE_BIT  OPTLY_BIT(APP_VERBOSE)
+#define APP_VERBOSE_WORD OPTLY_WORD(APP_VERBOSE)
+#define APP_THREADS_BIT  OPTLY_BIT(APP_THREADS)
+#define APP_THREADS_WORD OPTLY_WORD(APP_THREADS)
+
+static uint32_t app_long_0(const char *name, size_t len) {
+  switch (len) {
+    case 7:
+      if (memcmp(name, "verbose", 7) == 0) return 1;
+      if (memcmp(name, "threads", 7) == 0) return 2;
+      break;
+    default:
+      break;
+  }
+
+  (void)name;
+  return 0;
+}
+
+static uint32_t app_commands_0(const char *name, size_t len) {
+  switch (len) {
+    case 5:
+      if (memcmp(name, "serve", 5) == 0) return 1;
+      if (memcmp(name, "check", 5) == 0) return 2;
+      break;
+    default:
+      break;
+  }
+
+  (void)name;
+  return 0;
+}
+
+static uint64_t app_masks_0[] = {0x0000000000000000ull};
+
+static const char app_usage_0[] =
+  "Example of generated lookup\n"
+  "\n"
+  "Usage: app [FLAGS] <COMMAND>\n"
+  "\n"
+  "COMMANDS\n"
+  "  serve  Start server\n"
+  "  check  Check config\n"
+  "  help   Show help for command\n"
+  "\n"
+  "FLAGS\n"
+  "  -V --verbose          Enable verbose output\n"
+  "  -t --threads <u32>    Worker threads (default: 4)\n"
+  "\n"
+  "  -h --help             Show this message\n";
+
+static OptlyIndex app_index_0 = {
+  .shorts        = {[86] = 1, [116] = 2},
+  .masks         = app_masks_0,
+  .match_long    = app_long_0,
+  .match_command = app_commands_0,
+  .usage         = app_usage_0,
+  .flags_count   = 2,
+  .groups_count  = 0,
+  .schema_hash   = 0x1b25a252u,
+};
+
+// serve
+
+enum {
+  APP_SERVE_PORT = 0,
+  APP_SERVE_HOST = 1,
+  APP_SERVE_TLS = 2,
+  APP_SERVE_CERT = 3,
+};
+
+#define APP_SERVE_PORT_BIT  OPTLY_BIT(APP_SERVE_PORT)
+#define APP_SERVE_PORT_WORD OPTLY_WORD(APP_SERVE_PORT)
+#define APP_SERVE_HOST_BIT  OPTLY_BIT(APP_SERVE_HOST)
+#define APP_SERVE_HOST_WORD OPTLY_WORD(APP_SERVE_HOST)
+#define APP_SERVE_TLS_BIT  OPTLY_BIT(APP_SERVE_TLS)
+#define APP_SERVE_TLS_WORD OPTLY_WORD(APP_SERVE_TLS)
+#define APP_SERVE_CERT_BIT  OPTLY_BIT(APP_SERVE_CERT)
+#define APP_SERVE_CERT_WORD OPTLY_WORD(APP_SERVE_CERT)
+
+static uint32_t app_long_1(const char *name, size_t len) {
+  switch (len) {
+    case 4:
+      if (memcmp(name, "port", 4) == 0) return 1;
+      if (memcmp(name, "host", 4) == 0) return 2;
+      if (memcmp(name, "cert", 4) == 0) return 4;
+      break;
+    case 3:
+      if (memcmp(name, "tls", 3) == 0) return 3;
+      break;
+    default:
+      break;
+  }
+
+  (void)name;
+  return 0;
+}
+
+static uint32_t app_commands_1(const char *name, size_t len) {
+  switch (len) {
+    default:
+      break;
+  }
+
+  (void)name;
+  return 0;
+}
+
+static uint64_t app_masks_1[] = {0x0000000000000000ull, 0x0000000000000008ull, 0x0000000000000004ull};
+
+static const char app_usage_1[] =
+  "Start server\n"
+  "\n"
+  "Usage: serve [FLAGS]\n"
+  "\n"
+  "FLAGS\n"
+  "  -p --port <u16>    Server port (default: 8080)\n"
+  "  --host <str>       Address to listen on (default: 0.0.0.0)\n"
+  "  --tls              Serve over TLS\n"
+  "  --cert <str>       TLS certificate\n"
+  "\n"
+  "  -h --help          Show this message\n";
+
+static OptlyIndex app_index_1 = {
+  .shorts        = {[112] = 1},
+  .masks         = app_masks_1,
+  .match_long    = app_long_1,
+  .match_command = app_commands_1,
+  .usage         = app_usage_1,
+  .flags_count   = 4,
+  .groups_count  = 1,
+  .schema_hash   = 0x8aaa30a1u,
+};
+
+// check
+
+enum {
+  APP_CHECK_STRICT = 0,
+};
+
+#define APP_CHECK_STRICT_BIT  OPTLY_BIT(APP_CHECK_STRICT)
+#define APP_CHECK_STRICT_WORD OPTLY_WORD(APP_CHECK_STRICT)
+
+static uint32_t app_long_2(const char *name, size_t len) {
+  switch (len) {
+    case 6:
+      if (memcmp(name, "strict", 6) == 0) return 1;
+      break;
+    default:
+      break;
+  }
+
+  (void)name;
+  return 0;
+}
+
+static uint32_t app_commands_2(const char *name, size_t len) {
+  switch (len) {
+    default:
+      break;
+  }
+
+  (void)name;
+  return 0;
+}
+
+static uint64_t app_masks_2[] = {0x0000000000000000ull};
+
+static const char app_usage_2[] =
+  "Check config\n"
+  "\n"
+  "Usage: check [FLAGS]\n"
+  "\n"
+  "FLAGS\n"
+  "  -s --strict          Fail on warnings\n"
+  "\n"
+  "  -h --help            Show this message\n";
+
+static OptlyIndex app_index_2 = {
+  .shorts        = {[115] = 1},
+  .masks         = app_masks_2,
+  .match_long    = app_long_2,
+  .match_command = app_commands_2,
+  .usage         = app_usage_2,
+  .flags_count   = 1,
+  .groups_count  = 0,
+  .schema_hash   = 0xb9d9e548u,
+};
+
+static OptlyIndex *const app_indexes[] = {&app_index_0, &app_index_1, &app_index_2};
+
+static inline bool app_install(OptlyCommand *command) {
+  return optly_install(command, app_indexes, 3);
+}
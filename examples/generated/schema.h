@@ -0,0 +1,45 @@
+// Schema shared by examples/generated.c and generator, see gen.sh.
+// Defines that change usage must be here, so both sides see the same ones.
+
+#define OPTLY_GEN_HELP_FLAG
+#define OPTLY_GEN_HELP_COMMAND
+#include <optly.h>
+
+static OptlyFlag app_flags[] = {
+  {.fullname = "verbose", .shortname = 'V', .description = "Enable verbose output", .type = OPTLY_TYPE_BOOL},
+  {.fullname = "threads", .shortname = 't', .description = "Worker threads", .value.as_uint32 = 4, .type = OPTLY_TYPE_UINT32},
+  NULL_FLAG,
+};
+
+static OptlyFlag serve_flags[] = {
+  {.fullname = "port", .shortname = 'p', .description = "Server port", .value.as_uint16 = 8080, .type = OPTLY_TYPE_UINT16},
+  {.fullname = "host", .description = "Address to listen on", .value.as_string = "0.0.0.0", .type = OPTLY_TYPE_STRING},
+  {.fullname = "tls", .description = "Serve over TLS", .type = OPTLY_TYPE_BOOL},
+  {.fullname = "cert", .description = "TLS certificate", .type = OPTLY_TYPE_STRING},
+  NULL_FLAG,
+};
+
+static const char *serve_tls[] = {"tls", "cert", NULL};
+
+static OptlyGroup serve_groups[] = {
+  {.kind = OPTLY_GROUP_REQUIRES, .flags = serve_tls},
+  {0},
+};
+
+static OptlyFlag check_flags[] = {
+  {.fullname = "strict", .shortname = 's', .description = "Fail on warnings", .type = OPTLY_TYPE_BOOL},
+  NULL_FLAG,
+};
+
+static OptlyCommand app_commands[] = {
+  {.name = "serve", .description = "Start server", .flags = serve_flags, .groups = serve_groups},
+  {.name = "check", .description = "Check config", .flags = check_flags},
+  NULL_COMMAND,
+};
+
+static OptlyCommand app = {
+  .name        = "app",
+  .description = "Example of generated lookup",
+  .flags       = app_flags,
+  .commands    = app_commands,
+};
@@ -0,0 +1,27 @@
+#!/bin/bash
+
+# Generates static lookup code for a schema header:
+#
+#   ./gen.sh <schema.h> <command variable> <prefix> <output.h>
+
+CFLAGS="-Wall -Wextra -std=c99 -pedantic"
+CLIBS="-I./"
+CC="${CC:-clang}"
+OUTDIR="./out"
+
+if [ $# -ne 4 ]; then
+  echo "Usage: $0 <schema.h> <command variable> <prefix> <output.h>"
+  exit 1
+fi
+
+set -e
+
+if [ ! -d "$OUTDIR" ]; then
+  mkdir -p "$OUTDIR";
+fi
+
+SCHEMA="$(realpath "$1")"
+
+$CC $CFLAGS $CLIBS -DOPTLY_GEN_SCHEMA="\"$SCHEMA\"" -DOPTLY_GEN_COMMAND="$2" -o "$OUTDIR/optly_gen" tools/optly_gen.c
+"$OUTDIR/optly_gen" "$3" > "$4.tmp"
+mv "$4.tmp" "$4"
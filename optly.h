@@ -12,10 +12,21 @@
   * Inline flag values (--threads=4)
   * Separate flag values (--threads 4)
   * Typed flag values
-  * Positional arguments
+  * Size, duration, rate and CPU list flags
+  * Custom flag types with your own converter
+  * Repeated and separated list flags
+  * Positional arguments, optionally typed
   * Optional commands
   * Optional flags
-  * No dynamic memory allocation
+  * Flag groups: exclusive, one-of, any-of, all-or-none, requires
+  * Reentrant parsing with const schema
+  * Build-time generated lookup and help for static schemas
+  * C++20 front-end (optly.hpp) with names resolved at compile time
+  * Flags bound directly to your variables
+  * Optional @file response files
+  * Incremental token-by-token parsing
+  * Batch parsing of many command lines across threads
+  * No dynamic memory allocation (unless `optly_parse_args` outgrows its static buffer)
   * Portable C (C99)
 
   Basic Usage
@@ -145,6 +156,43 @@
 
     -abc  ->  -a -b -c
 
+  Integer values may be written in hex, octal or binary and use `_` between digits.
+  Values that don't fit flag type are errors, not truncated. Numbers never depend
+  on locale.
+
+    --mask=0xFF_FF  --mode=0o755 (or 0755)  --bits=0b1010  --count=1_000_000
+
+  Unit types are converted while parsing: size (bytes, K/KiB = 1024, KB = 1000),
+  duration (nanoseconds, ns/us/ms/s/m/h/d), rate (per second) and CPU list.
+
+    --cache=4GiB  --timeout=1h30m  --rate=10k/s  --cpus=0-7,16-23
+
+  Any other type can be parsed by your converter (see OptlyConverter):
+
+    optly_flag_custom("listen", .value.as_custom = &listen, .converter = &endpoint)
+
+  Enum flags also keep position of selected value, so you can switch on it:
+
+    switch (optly_flag_value_enum_index(&cmd, "log")) { ... }  // or optly_result_enum()
+
+  List flags append every occurrence (and every separated part) to array of flag type:
+
+    optly_flag_uint32("shard", .list = &shards, .separator = ',')  // --shard=1,2 --shard 3
+
+  `optly_parse_args` fills `shards` itself, up to its capacity, so it takes as many values
+  as you give room for.
+
+  Flag groups
+  -----------
+
+  Command can declare relations between its flags. They are checked after parsing
+  and failed groups are reported as OPTLY_ERR_CONSTRAINT:
+
+    .groups = optly_groups(
+      optly_group(OPTLY_GROUP_EXCLUSIVE, "json", "yaml"),
+      optly_group(OPTLY_GROUP_REQUIRES, "password", "user")  // --password needs --user
+    )
+
   Positional Arguments
   --------------------
 
@@ -164,6 +212,251 @@
       // ...
     }
 
+  There is no limit on number of values. `optly_parse_args` keeps them in its own
+  memory and leaves argv as is, unless OPTLY_ARGV_POSITIONALS is defined, see below.
+
+  If you only need to visit every value once, give the last variadic positional
+  `on_value` callback. Values are passed to it as they are read (with their argv
+  index) and not stored, only counted, so min/max are still checked:
+
+    void on_file(const OptlyCommand *cmd, char *value, int index, void *ctx) { ... }
+
+    optly_positional("files", .min = 1, .max = 0, .on_value = on_file, .ctx = &state)
+
+  Positional with `type` gets its values converted into contiguous array
+  (`OptlyValues.typed`, or your `list` with `optly_parse_args`):
+
+    optly_positional("ids", .min = 1, .max = 0, .type = OPTLY_TYPE_UINT64, .list = &ids)
+
+  Reentrant parsing
+  -----------------
+
+  `optly_parse_args` stores results inside of command definitions, so one schema
+  can serve only one parse at a time. `optly_parse` takes const schema and puts
+  everything into `OptlyResult` backed by your memory (stack, arena, whatever):
+
+    char        buf[4096];
+    OptlyResult res = optly_result(buf, sizeof(buf));
+
+    if (!optly_parse(&schema, argc, argv, &res)) {
+      optly_error_print(&res.errors);
+    }
+
+    for (const OptlyResultCommand *c = res.commands; c; c = c->next) {
+      printf("%s threads=%u\n", c->command->name, optly_result_value(c, "threads").as_uint32);
+    }
+
+  Same schema can be parsed by any number of threads at once. Result can be reused,
+  every parse starts from scratch. If buffer is too small OPTLY_ERR_OUT_OF_MEMORY is
+  reported. `optly_parse` never exits, broken schema (like two variadic positionals)
+  is reported as error too. Only `optly_parse_args` exits.
+
+  `optly_parse` never writes into schema, so it can be `static const` and stay in
+  read-only pages shared by forked workers. Pointers in definitions are not const
+  for sake of `optly_parse_args`, cast them:
+
+    static const OptlyFlag    flags[] = {{.fullname = "threads", .type = OPTLY_TYPE_UINT32}, NULL_FLAG};
+    static const OptlyCommand schema  = {.name = "app", .flags = (OptlyFlag *)flags};
+
+  State of each command is one OPTLY_CACHE_LINE aligned block in result arena: header,
+  bits of present and bool flags in the same line, then values one after another.
+  `optly_result_size(&schema)` tells how much the longest command chain needs,
+  positional values and lists come on top.
+
+  If you don't know how much memory you need give arena a `grow` callback. It is
+  called when arena is full and should switch it to a fresh block:
+
+    bool grow(OptlyArena *arena, size_t need) {
+      size_t size = need > 1 << 20 ? need : 1 << 20;
+      arena->base = malloc(size);  // Keep track of it to free later
+      arena->size = size;
+      arena->used = 0;
+      return arena->base != NULL;
+    }
+
+    res.arena.grow = grow;
+
+  `optly_parse_args` works the same way under the hood and copies results back into
+  the schema. It starts with OPTLY_PARSE_BUFFER_LENGTH bytes of static memory and
+  grows with malloc when a schema needs more. Positional values of every call stay
+  there, so blocks are never freed. That is the only place Optly allocates on its
+  own, and it is not thread safe either.
+
+  If argv may be reordered, positional values can live in it instead:
+
+    #define OPTLY_ARGV_POSITIONALS
+
+  Stored positional values are then moved to the front of argv, in order, and every
+  other argument is behind them in unspecified order. Nothing is lost or duplicated,
+  but `app -v a -v b` is `app a b -v -v` afterwards. Memory is reused by next call.
+
+  Feeding tokens
+  --------------
+
+  When arguments arrive one by one (interactive shell, network protocol) feed
+  them to the parser as they come. Parser keeps current command, flag waiting
+  for its value and `--` state between calls:
+
+    OptlyParser parser;
+    optly_parser_init(&parser, &schema, &res);
+
+    while ((token = next_token())) {
+      if (!optly_parser_feed(&parser, token)) {
+        // This token caused an error, see res.errors
+      }
+    }
+
+    optly_parser_finish(&parser);  // Required flags, positional counts
+
+  Tokens must stay alive as long as results are used.
+
+  Parsing a line
+  --------------
+
+  Commands that come as text (sockets, REPLs) don't need a shell to be split.
+  `optly_parse_line` splits mutable line in place with the same quoting rules
+  as response files, puts tokens into your array and runs `optly_parse`:
+
+    char        line[] = "deploy 'my service' -r 3";
+    char       *argv[64];
+    OptlyResult res = optly_result(buf, sizeof(buf));
+
+    optly_parse_line(&schema, line, argv, 64, &res);
+
+  Line has no program name, `schema.name` is used for it. If tokens don't fit
+  into argv OPTLY_ERR_OUT_OF_MEMORY is reported, quote left open is
+  OPTLY_ERR_UNCLOSED_QUOTE (response files report it too). Nothing is parsed then.
+
+  Batch parsing
+  -------------
+
+  Many independent command lines (say, submitted jobs) are parsed against one
+  schema with `optly_parse_batch`. Threads take items in chunks of OPTLY_BATCH_CHUNK
+  from one shared counter, so the ones that finish early take more. There are no
+  per-thread queues or stealing, chunks are small enough to balance. Threads need
+  POSIX:
+
+    #define _DEFAULT_SOURCE  // Or compile with -std=gnu99, and link with -pthread
+    #define OPTLY_THREADS
+
+  Without it everything runs on calling thread. Errors of every item go to your sink,
+  batch reports throughput:
+
+    OptlyArgv  jobs[N];    // {argc, argv} of every item
+    OptlyBatch batch = {.on_error = sink, .ctx = &state};
+
+    optly_parse_batch(&schema, jobs, N, results, 8, &batch);  // results can be NULL to only validate
+    printf("%zu failed, %.0f/s\n", batch.failed, batch.per_second);
+
+  Each of `results` needs its own buffer. Without them every thread validates into
+  `optly_result_size(&schema)` + OPTLY_PARSE_BUFFER_LENGTH bytes of its stack. Sink
+  is called from worker threads.
+
+  Response files
+  --------------
+
+  Command lines longer than ARG_MAX can be passed in files: `app @args.txt`.
+  Enable it (POSIX only) with
+
+    #define _DEFAULT_SOURCE  // Or compile with -std=gnu99
+    #define OPTLY_RESPONSE_FILES
+
+  File is mapped privately and split into tokens in place: whitespace separates
+  them, '...' and "..." quote, backslash escapes. Tokens are not copied, argv
+  points right into the mapping. Files may include other files up to
+  OPTLY_RESPONSE_FILE_DEPTH levels (deeper ones are OPTLY_ERR_RESPONSE_FILE_DEPTH),
+  each file is limited by OPTLY_RESPONSE_FILE_MAX_SIZE.
+  Nothing after `--` is expanded.
+
+  `optly_parse_args` expands them by itself and keeps mappings until exit. With
+  `optly_parse` expand first and free when you are done with results:
+
+    OptlyResponseFiles files = {0};
+    OptlyErrors        errs  = {0};
+
+    optly_expand_response_files(&argc, &argv, &files, &errs);
+    optly_parse(&schema, argc, argv, &res);
+    ...
+    optly_response_files_free(&files);
+
+  Compiled lookup
+  ---------------
+
+  By default flags are looked up by scanning command's flags array. For commands
+  with a lot of flags you can build lookup tables once before parsing:
+
+    static char buf[1 << 16];
+    OptlyArena  arena = optly_arena(buf, sizeof(buf));
+
+    optly_compile(&cmd, &arena);  // optly_compile_size(&cmd) tells how much memory it needs
+
+  Compilation walks whole command tree and makes each flag and subcommand lookup O(1),
+  same for values of enums with at least OPTLY_ENUM_INDEX_MIN values. Arena memory
+  must outlive the command.
+
+  Generated lookup
+  ----------------
+
+  Static schema can be compiled at build time: `./gen.sh schema.h app app app_gen.h`
+  builds tools/optly_gen.c (which defines OPTLY_GENERATOR and calls `optly_generate`)
+  with your schema header and emits name matchers, flag position constants, masks
+  and rendered usage of every command. Then
+
+    #include "app_gen.h"
+
+    app_install(&app);  // optly_install under the hood, false if any command changed since generation
+
+  Defines that change usage have to be in the schema header, so generator sees them.
+
+  Lazy commands
+  -------------
+
+  Big command trees don't have to be built up front. Declare a stub with a provider
+  and it will be called only when parser descends into that command:
+
+    OptlyCommand *load_deploy(const OptlyCommand *stub) {
+      static OptlyCommand deploy;
+      static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+      pthread_once(&once, build_deploy);  // Fills `deploy`
+      return &deploy;
+    }
+
+    optly_command("deploy", "Deploy service", .provider = load_deploy)
+
+  Provider is called every time parser gets to the stub, from any thread that
+  parses, so it must return the same command each time and must not touch the stub
+  (it may be in read-only memory). Build the command once and hand out the same one.
+  `optly_compile` skips provided commands, provider can compile what it returns.
+
+  Binding and handles
+  -------------------
+
+  Flag can write its value straight into your variable. Use `bind` member that
+  matches flag type:
+
+    uint32_t threads = 4;
+    optly_flag_uint32("threads", 't', "Worker threads", .bind.as_uint32 = &threads)
+
+  Typed constructors only take `bind` member of their type, `.bind.as_uint32` on
+  optly_flag_uint64 doesn't compile. Plain `optly_flag` with `.type` isn't checked.
+
+  Bound variable is written by both `optly_parse_args` and `optly_parse`, so
+  don't bind flags of a schema shared between threads.
+
+  Reading by name costs a lookup every time. Resolve handle once and then read
+  by index:
+
+    OptlyHandle threads = optly_flag_handle(&cmd, "threads");
+    optly_result_flag(res.commands, threads).as_uint32;  // or cmd.flags[threads].value
+
+  Bool flags are packed into bits at their positions, so checks are one load:
+
+    if (res.commands->bools[OPTLY_WORD(OPT_VERBOSE)] & OPTLY_BIT(OPT_VERBOSE)) { ... }  // or cmd.bools
+
+  `cmd.bools` holds OPTLY_BOOL_WORDS words (64 flags each), generator refuses bool
+  flags past them.
+
   Help and version command/flag generation
   ----------------------------
 
@@ -179,11 +472,27 @@
 
   to generate version flag `--version | -v` and/or version command `version`.
 
-  If help/version command/flag would be found during parsing usage would be
-  automatically called and `exit(0)` is called.
+  `optly_parse_args` prints usage or version when help/version command/flag is
+  found and calls `exit(0)`. Everything else only reports it in the result and
+  stops taking arguments, printing is up to you:
+
+    optly_parse(&schema, argc, argv, &res);
+
+    if (res.help) {
+      optly_usage(res.help);  // Command of 'help <command>' too, NULL if it is unknown
+    } else if (res.version) {
+      printf("%s\n", APP_VERSION);
+    }
+
+  Validation is skipped then, so required flags don't get in the way.
 
   Note that user defined flags with `-h`/`-v` would interfere with generated flags.
 
+  Usage can also be printed by hand with `optly_usage(&cmd)`, into any stream with
+  `optly_usage_to_file` or into your buffer with `optly_usage_to_buffer`, which works
+  like snprintf. Help is rendered into OPTLY_USAGE_BUFFER_LENGTH bytes on stack and
+  written with one call.
+
   Error and logging handling
   --------------
 
@@ -233,11 +542,16 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #ifndef OPTLYDEF
 #define OPTLYDEF
 #endif  // OPTLYDEF
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // Versioning macros
 #define OPTLY_VERSION_MAJOR         2
 #define OPTLY_VERSION_MINOR         3
@@ -248,20 +562,70 @@
 #define OPTLY_EXPAND_AND_QUOTE(str) OPTLY_QUOTE(str)
 #define OPTLY_VERSION_STRING        OPTLY_EXPAND_AND_QUOTE(OPTLY_VERSION_FULL)
 
-// If you need more that 64 positional arguments per ONE command
-// you should look in the mirror really deep
-#ifndef OPTLY_MAX_POSITIONALS
-#define OPTLY_MAX_POSITIONALS 64
-#endif
-
 #ifndef OPTLY_FLAG_BUFFER_LENGTH
 #define OPTLY_FLAG_BUFFER_LENGTH 256
 #endif
 
+// Help is rendered into a stack buffer of this size and written in one go, longer help takes several writes
+#ifndef OPTLY_USAGE_BUFFER_LENGTH
+#define OPTLY_USAGE_BUFFER_LENGTH 8192
+#endif
+
+// Words of `OptlyCommand.bools`, bool flags at positions past 64 * this are not there
+#ifndef OPTLY_BOOL_WORDS
+#define OPTLY_BOOL_WORDS 1
+#endif
+
+// Alignment of every command state in parse result
+#ifndef OPTLY_CACHE_LINE
+#define OPTLY_CACHE_LINE 64
+#endif
+
+// Items taken by batch worker at once
+#ifndef OPTLY_BATCH_CHUNK
+#define OPTLY_BATCH_CHUNK 64
+#endif
+
+#ifndef OPTLY_BATCH_MAX_THREADS
+#define OPTLY_BATCH_MAX_THREADS 64
+#endif
+
+// Highest CPU number + 1 that fits into OptlyCpuSet
+#ifndef OPTLY_MAX_CPUS
+#define OPTLY_MAX_CPUS 1024
+#endif
+
+// Enums with at least this many values get hashed lookup from `optly_compile`
+#ifndef OPTLY_ENUM_INDEX_MIN
+#define OPTLY_ENUM_INDEX_MIN 16
+#endif
+
+// Enum index when flag has no value (no default and not given)
+#define OPTLY_ENUM_NONE UINT32_MAX
+
 #ifndef OPTLY_MAX_ERRORS
 #define OPTLY_MAX_ERRORS 32
 #endif
 
+// Static memory `optly_parse_args` starts with for parse state of selected commands
+// and positional values, more is taken with malloc when it doesn't fit
+#ifndef OPTLY_PARSE_BUFFER_LENGTH
+#define OPTLY_PARSE_BUFFER_LENGTH 16384
+#endif
+
+// Response files (@file) limits. Depth counts files included from files.
+#ifndef OPTLY_RESPONSE_FILES_MAX
+#define OPTLY_RESPONSE_FILES_MAX 32
+#endif
+
+#ifndef OPTLY_RESPONSE_FILE_DEPTH
+#define OPTLY_RESPONSE_FILE_DEPTH 8
+#endif
+
+#ifndef OPTLY_RESPONSE_FILE_MAX_SIZE
+#define OPTLY_RESPONSE_FILE_MAX_SIZE (64 << 20)
+#endif
+
 #ifndef OPTLY_HELP_SHORT_FLAG
 #define OPTLY_HELP_SHORT_FLAG "-h"
 #endif
@@ -285,8 +649,32 @@ typedef enum OptlyFlagType {
   OPTLY_TYPE_FLOAT,
   OPTLY_TYPE_DOUBLE,
   OPTLY_TYPE_ENUM,
+  OPTLY_TYPE_SIZE,      // Bytes in `as_uint64`: 4096, 4k, 4KiB, 1.5GB
+  OPTLY_TYPE_DURATION,  // Nanoseconds in `as_int64`: 250ms, 1h30m, 1.5s
+  OPTLY_TYPE_RATE,      // Events per second in `as_double`: 100, 10k/s, 5/ms
+  OPTLY_TYPE_CPUSET,    // CPU list in `as_cpuset`: 0-7,16-23
+  OPTLY_TYPE_CUSTOM,    // Your type in `as_custom`, converted by `converter`
 } OptlyFlagType;
 
+typedef struct OptlyCpuSet {
+  uint64_t bits[(OPTLY_MAX_CPUS + 63) / 64];
+} OptlyCpuSet;
+
+static inline bool optly_cpuset_has(const OptlyCpuSet *set, size_t cpu) {
+  return cpu < OPTLY_MAX_CPUS && (set->bits[cpu / 64] >> (cpu % 64)) & 1;
+}
+
+// Values of list flag, one element per occurrence (or separated part). Element
+// type is flag type's member of OptlyFlagValue: `char *` for strings, `uint32_t`
+// for u32 and so on. Read with `optly_list_at(list, uint32_t, i)`.
+typedef struct OptlyList {
+  void  *items;
+  size_t count;
+  size_t capacity;  // In elements
+} OptlyList;
+
+#define optly_list_at(list, type, i) (((type *)(list)->items)[i])
+
 typedef union OptlyFlagValue {
   bool as_bool;
 
@@ -306,9 +694,67 @@ typedef union OptlyFlagValue {
 
   float  as_float;
   double as_double;
+
+  // NOTE: Set is too big to live in every flag. Default must point at your
+  //       OptlyCpuSet, `optly_parse_args` copies parsed set there
+  OptlyCpuSet *as_cpuset;
+
+  // NOTE: Same as `as_cpuset`: points at your variable of converter type
+  void *as_custom;
+
+  OptlyList *as_list;  // Only in parse result, schema keeps it in `OptlyFlag.list`
 } OptlyFlagValue;
 
-typedef struct {
+// Where parser should also store flag value. Use member that matches flag type,
+// so compiler checks your variable type: `.bind.as_uint32 = &threads`. Typed
+// constructors (optly_flag_uint32 and such) refuse other members at compile time.
+typedef union OptlyFlagBind {
+  void *as_any;
+
+  bool *as_bool;
+
+  char  *as_char;
+  char **as_string;
+  char **as_enum;  // Receives selected value
+
+  int8_t  *as_int8;
+  int16_t *as_int16;
+  int32_t *as_int32;
+  int64_t *as_int64;
+
+  uint8_t  *as_uint8;
+  uint16_t *as_uint16;
+  uint32_t *as_uint32;
+  uint64_t *as_uint64;
+
+  float  *as_float;
+  double *as_double;
+
+  OptlyCpuSet *as_cpuset;
+  void        *as_custom;
+} OptlyFlagBind;
+
+typedef struct OptlyFlag OptlyFlag;
+
+// Converts `value` into `out` (converter `size` bytes). Returns NULL on success
+// or reason why value is invalid.
+typedef const char *(*OptlyConvertFn)(const OptlyFlag *flag, const char *value, void *out);
+
+// Writes `value` for help output. Optional, default isn't shown without it.
+typedef void (*OptlyFormatFn)(const OptlyFlag *flag, const void *value, char *buf, size_t size);
+
+// C99 has no _Alignof
+#define OPTLY_ALIGNOF(type) offsetof(struct { char c; type t; }, t)
+
+typedef struct OptlyConverter {
+  const char    *type_name;  // Shown in help, like "<endpoint>"
+  size_t         size;       // sizeof your type
+  size_t         align;      // OPTLY_ALIGNOF(your type), 0 for pointer alignment
+  OptlyConvertFn convert;
+  OptlyFormatFn  format;
+} OptlyConverter;
+
+struct OptlyFlag {
   char *fullname;
   char  shortname;
   char *description;
@@ -318,7 +764,24 @@ typedef struct {
 
   OptlyFlagValue value;
   OptlyFlagType  type;
-} OptlyFlag;
+
+  OptlyFlagBind bind;
+
+  const OptlyConverter *converter;  // Only for OPTLY_TYPE_CUSTOM
+
+  uint32_t enum_index;  // Selected enum value (or OPTLY_ENUM_NONE), written by `optly_parse_args`
+
+  // Makes it list flag: each occurrence is appended instead of overwriting. List
+  // is default and receives result of `optly_parse_args`, up to its capacity.
+  OptlyList *list;
+  char       separator;  // Also split every value on it, like ',' for --shard=1,2,3
+};
+
+typedef struct OptlyCommand OptlyCommand;
+
+// Gets every value of streamed positional as soon as it is read. `index` is
+// position of the value in argv.
+typedef void (*OptlyValueCallback)(const OptlyCommand *command, char *value, int index, void *ctx);
 
 typedef struct {
   char *name;
@@ -327,11 +790,101 @@ typedef struct {
   size_t min;
   size_t max;
 
-  char  *values[OPTLY_MAX_POSITIONALS];
+  char **values;  // Points into argv after `optly_parse_args`
   size_t count;
+
+  // Only for the last positional with max = 0. Values are passed here instead
+  // of being stored, `values` stays NULL and `count` only counts them.
+  OptlyValueCallback on_value;
+  void              *ctx;
+
+  // Scalar type (not enum or custom) to convert values to, 0 or OPTLY_TYPE_STRING
+  // keeps just strings. Converted array is `OptlyValues.typed` in parse result,
+  // `optly_parse_args` converts right into `list`, up to its capacity.
+  OptlyFlagType type;
+  OptlyList    *list;
 } OptlyPositional;
 
-typedef struct OptlyCommand OptlyCommand;
+typedef struct OptlyArena OptlyArena;
+
+// Called when arena runs out. Point `base`, `size` and `used` at a fresh block
+// with at least `need` free bytes and return true. Previous block must stay
+// alive as long as anything allocated from it is used.
+typedef bool (*OptlyArenaGrow)(OptlyArena *arena, size_t need);
+
+// Caller-owned bump allocator. Optly never calls malloc (except for growing
+// `optly_parse_args` memory), everything it needs beyond the schema itself is
+// carved out of memory you hand over.
+struct OptlyArena {
+  unsigned char *base;
+  size_t         size;
+  size_t         used;
+
+  OptlyArenaGrow grow;  // Optional
+  void          *ctx;   // For `grow`, optly doesn't touch it
+};
+
+#define optly_arena(buf, sz)                              \
+  (OptlyArena) {                                          \
+    .base = (unsigned char *)(buf), .size = (sz), .used = 0 \
+  }
+
+typedef struct OptlyIndexSlot {
+  const char *name;
+  uint32_t    len;  // strlen(name), names are compared on known length
+  uint32_t    hash;
+  uint32_t    index;  // Position in array + 1, 0 marks an empty slot
+} OptlyIndexSlot;
+
+typedef struct OptlyIndexTable {
+  OptlyIndexSlot *slots;  // NULL if values are scanned linearly
+  size_t          mask;
+} OptlyIndexTable;
+
+typedef enum OptlyGroupKind {
+  OPTLY_GROUP_EXCLUSIVE,    // At most one of flags
+  OPTLY_GROUP_ONE_OF,       // Exactly one of flags
+  OPTLY_GROUP_ANY_OF,       // At least one of flags
+  OPTLY_GROUP_ALL_OR_NONE,  // Either all flags or none of them
+  OPTLY_GROUP_REQUIRES,     // If first flag is given, all others must be too
+} OptlyGroupKind;
+
+// Constraint on flags of one command, checked after parsing
+typedef struct OptlyGroup {
+  OptlyGroupKind kind;
+  const char   **flags;  // Long names, NULL terminated
+  const char    *name;   // Reported in error, first flag name if NULL
+} OptlyGroup;
+
+// Matches `len` bytes of name (not NUL terminated) and returns position + 1, 0 if nothing matches
+typedef uint32_t (*OptlyMatchFn)(const char *name, size_t len);
+
+// Lookup tables built by `optly_compile` or emitted by `optly_generate`. Commands without index are scanned linearly.
+typedef struct OptlyIndex {
+  uint16_t         shorts[256];  // Flag position + 1 for every short name, 0 if none
+  OptlyIndexSlot  *longs;        // Open-addressed table of long flag names
+  size_t           longs_mask;
+  OptlyIndexSlot  *commands;     // Open-addressed table of subcommand names
+  size_t           commands_mask;
+  OptlyIndexTable *enums;        // Value table per flag, NULL if command has no big enums
+  uint64_t        *masks;        // Flag bitmasks for validation, see optly__build_masks
+
+  // Generated code: matchers used instead of `longs` and `commands` tables,
+  // and usage text printed as is when command is shown under its own name
+  OptlyMatchFn match_long;
+  OptlyMatchFn match_command;
+  const char  *usage;
+
+  // Shape of the command code was generated from, `optly_install` refuses stale code
+  uint32_t flags_count;
+  uint32_t groups_count;
+  uint32_t schema_hash;  // See optly_schema_hash
+} OptlyIndex;
+
+// Called when parser descends into command that has it, on every parse and maybe from
+// many threads at once. Returns full definition of the command, separate from `stub`,
+// or NULL if it can't be built. Same stub must always give the same command.
+typedef OptlyCommand *(*OptlyCommandProvider)(const OptlyCommand *stub);
 
 struct OptlyCommand {
   char *name;
@@ -342,6 +895,15 @@ struct OptlyCommand {
   OptlyPositional *positionals;
 
   OptlyCommand *next_command;
+
+  OptlyIndex          *index;
+  OptlyCommandProvider provider;
+
+  OptlyGroup *groups;  // Ends with group without flags
+
+  // Values of bool flags among first 64 * OPTLY_BOOL_WORDS as bits at flag positions,
+  // written by `optly_parse_args`. Test with `cmd.bools[OPTLY_WORD(i)] & OPTLY_BIT(i)`.
+  uint64_t bools[OPTLY_BOOL_WORDS];
 };
 
 typedef enum OptlyErrorKind {
@@ -355,6 +917,11 @@ typedef enum OptlyErrorKind {
   OPTLY_ERR_POSITIONAL_TOO_MANY,
   OPTLY_ERR_DUPLICATE_VARIADIC,
   OPTLY_ERR_BATCH_NON_BOOL,
+  OPTLY_ERR_OUT_OF_MEMORY,
+  OPTLY_ERR_RESPONSE_FILE,
+  OPTLY_ERR_CONSTRAINT,
+  OPTLY_ERR_RESPONSE_FILE_DEPTH,
+  OPTLY_ERR_UNCLOSED_QUOTE,
   Count_OptlyError
 } OptlyErrorKind;
 
@@ -368,6 +935,68 @@ typedef struct OptlyErrors {
   size_t     count;
 } OptlyErrors;
 
+typedef struct OptlyValues {
+  char **items;
+  size_t count;
+  void  *typed;  // `count` values of positional type, NULL for string positionals
+} OptlyValues;
+
+typedef struct OptlyResultCommand OptlyResultCommand;
+
+// Parse state of one command in selected chain
+struct OptlyResultCommand {
+  const OptlyCommand *command;
+  OptlyFlagValue     *values;       // One per flag in `command->flags` order, default value if flag is not present
+  uint64_t           *present;      // Bit per flag
+  OptlyValues        *positionals;  // One per positional in `command->positionals` order
+  OptlyResultCommand *next;         // Selected subcommand
+  uint64_t           *bools;        // Bit per flag, set for bool flags that are true
+};
+
+// Output of `optly_parse`. Schema stays untouched, everything lives in the arena.
+typedef struct OptlyResult {
+  OptlyArena          arena;
+  OptlyErrors         errors;
+  OptlyResultCommand *commands;  // Main command first, then selected subcommands
+
+  const OptlyCommand *help;     // Generated help was asked for this command
+  bool                version;  // Generated version was asked for
+} OptlyResult;
+
+#define optly_result(buf, sz)           \
+  (OptlyResult) {                       \
+    .arena = optly_arena((buf), (sz))   \
+  }
+
+// Everything parser needs between tokens, for feeding it tokens one by one.
+// Treat it as opaque, results go into `result`, schema is never touched.
+typedef struct OptlyParser {
+  OptlyResult        *result;
+  OptlyResultCommand *level;  // State of currently selected command
+
+  const OptlyCommand *main;
+  const char         *name;
+  const char         *version;
+
+  char **run;  // Positional values of current command in order they came
+  size_t run_count;
+  size_t run_capacity;
+
+  char **slots;  // If set, runs are compacted into argv here instead of arena
+  size_t index;  // Position of current token in argv
+
+  bool in_schema;  // `optly_parse_args`: lists are filled right in schema, up to capacity caller gave them
+
+  const OptlyPositional *stream;        // Last positional of current command if it streams
+  size_t                 stream_after;  // Values to store for positionals before it
+
+  const OptlyFlag *pending;          // Flag waiting for its value in the next token
+  bool             positional_only;  // '--' was seen
+  bool             help;             // 'help' command waits for its target
+  bool             stopped;          // Help or version was asked for, rest is ignored
+  bool             out_of_memory;    // Parsing stops, nothing else would fit anyway
+} OptlyParser;
+
 OPTLYDEF size_t      optly_errors_count(const OptlyErrors *errs);
 OPTLYDEF OptlyError  optly_errors_at(const OptlyErrors *errs, size_t i);
 OPTLYDEF const char *optly_error_message(OptlyErrorKind err);
@@ -384,6 +1013,14 @@ OPTLYDEF void        optly_error_print(const OptlyErrors *errs);
     .present  = false                \
   }
 
+#define optly_group(kind_, ...) \
+  { .kind = (kind_), .flags = (const char *[]){__VA_ARGS__, NULL} }
+
+#define optly_groups(...) \
+  (OptlyGroup[]) {        \
+    __VA_ARGS__, { 0 }    \
+  }
+
 #define optly_command(namme, ...) \
   (OptlyCommand) {                \
     .name = (namme), __VA_ARGS__  \
@@ -407,20 +1044,47 @@ OPTLYDEF void        optly_error_print(const OptlyErrors *errs);
     __VA_ARGS__, NULL_POSITIONAL \
   }
 
-#define optly_flag_bool(name, ...)   optly_flag(name, __VA_ARGS__, .type = OPTLY_TYPE_BOOL)
-#define optly_flag_char(name, ...)   optly_flag(name, __VA_ARGS__, .type = OPTLY_TYPE_CHAR)
-#define optly_flag_string(name, ...) optly_flag(name, __VA_ARGS__, .type = OPTLY_TYPE_STRING)
-#define optly_flag_int8(name, ...)   optly_flag(name, __VA_ARGS__, .type = OPTLY_TYPE_INT8)
-#define optly_flag_int16(name, ...)  optly_flag(name, __VA_ARGS__, .type = OPTLY_TYPE_INT16)
-#define optly_flag_int32(name, ...)  optly_flag(name, __VA_ARGS__, .type = OPTLY_TYPE_INT32)
-#define optly_flag_int64(name, ...)  optly_flag(name, __VA_ARGS__, .type = OPTLY_TYPE_INT64)
-#define optly_flag_uint8(name, ...)  optly_flag(name, __VA_ARGS__, .type = OPTLY_TYPE_UINT8)
-#define optly_flag_uint16(name, ...) optly_flag(name, __VA_ARGS__, .type = OPTLY_TYPE_UINT16)
-#define optly_flag_uint32(name, ...) optly_flag(name, __VA_ARGS__, .type = OPTLY_TYPE_UINT32)
-#define optly_flag_uint64(name, ...) optly_flag(name, __VA_ARGS__, .type = OPTLY_TYPE_UINT64)
-#define optly_flag_float(name, ...)  optly_flag(name, __VA_ARGS__, .type = OPTLY_TYPE_FLOAT)
-#define optly_flag_double(name, ...) optly_flag(name, __VA_ARGS__, .type = OPTLY_TYPE_DOUBLE)
-#define optly_flag_enum(name, ...)   optly_flag(name, __VA_ARGS__, .type = OPTLY_TYPE_ENUM)
+// Typed constructors check initializer once more, under sizeof so nothing is
+// evaluated, as a copy of OptlyFlag whose bind has only the member of flag type.
+// So `.bind.as_uint32 = &n` on optly_flag_uint64 doesn't compile. Keep fields
+// in sync with OptlyFlag.
+#define optly__flag_typed(name, kind, member, type_, ...)                  \
+  optly_flag(name, __VA_ARGS__, .type = (OptlyFlagType)(kind + 0 * sizeof( \
+    (struct {                                                            \
+      char                 *fullname;                                    \
+      char                  shortname;                                   \
+      char                 *description;                                 \
+      bool                  required;                                    \
+      bool                  present;                                     \
+      OptlyFlagValue        value;                                       \
+      OptlyFlagType         type;                                        \
+      union { type_ *member; } bind;                                     \
+      const OptlyConverter *converter;                                   \
+      uint32_t              enum_index;                                  \
+      OptlyList            *list;                                        \
+      char                  separator;                                   \
+    }){.fullname = (name), __VA_ARGS__})))
+
+#define optly_flag_bool(name, ...)   optly__flag_typed(name, OPTLY_TYPE_BOOL, as_bool, bool, __VA_ARGS__)
+#define optly_flag_char(name, ...)   optly__flag_typed(name, OPTLY_TYPE_CHAR, as_char, char, __VA_ARGS__)
+#define optly_flag_string(name, ...) optly__flag_typed(name, OPTLY_TYPE_STRING, as_string, char *, __VA_ARGS__)
+#define optly_flag_int8(name, ...)   optly__flag_typed(name, OPTLY_TYPE_INT8, as_int8, int8_t, __VA_ARGS__)
+#define optly_flag_int16(name, ...)  optly__flag_typed(name, OPTLY_TYPE_INT16, as_int16, int16_t, __VA_ARGS__)
+#define optly_flag_int32(name, ...)  optly__flag_typed(name, OPTLY_TYPE_INT32, as_int32, int32_t, __VA_ARGS__)
+#define optly_flag_int64(name, ...)  optly__flag_typed(name, OPTLY_TYPE_INT64, as_int64, int64_t, __VA_ARGS__)
+#define optly_flag_uint8(name, ...)  optly__flag_typed(name, OPTLY_TYPE_UINT8, as_uint8, uint8_t, __VA_ARGS__)
+#define optly_flag_uint16(name, ...) optly__flag_typed(name, OPTLY_TYPE_UINT16, as_uint16, uint16_t, __VA_ARGS__)
+#define optly_flag_uint32(name, ...) optly__flag_typed(name, OPTLY_TYPE_UINT32, as_uint32, uint32_t, __VA_ARGS__)
+#define optly_flag_uint64(name, ...) optly__flag_typed(name, OPTLY_TYPE_UINT64, as_uint64, uint64_t, __VA_ARGS__)
+#define optly_flag_float(name, ...)  optly__flag_typed(name, OPTLY_TYPE_FLOAT, as_float, float, __VA_ARGS__)
+#define optly_flag_double(name, ...) optly__flag_typed(name, OPTLY_TYPE_DOUBLE, as_double, double, __VA_ARGS__)
+#define optly_flag_enum(name, ...)   optly__flag_typed(name, OPTLY_TYPE_ENUM, as_enum, char *, __VA_ARGS__)
+
+#define optly_flag_size(name, ...)     optly__flag_typed(name, OPTLY_TYPE_SIZE, as_uint64, uint64_t, __VA_ARGS__)
+#define optly_flag_duration(name, ...) optly__flag_typed(name, OPTLY_TYPE_DURATION, as_int64, int64_t, __VA_ARGS__)
+#define optly_flag_rate(name, ...)     optly__flag_typed(name, OPTLY_TYPE_RATE, as_double, double, __VA_ARGS__)
+#define optly_flag_cpuset(name, ...)   optly__flag_typed(name, OPTLY_TYPE_CPUSET, as_cpuset, OptlyCpuSet, __VA_ARGS__)
+#define optly_flag_custom(name, ...)   optly__flag_typed(name, OPTLY_TYPE_CUSTOM, as_custom, void, __VA_ARGS__)
 
 #define optly_enum_values(default, ...) \
   .value.as_enum = (char *[]) {         \
@@ -429,15 +1093,126 @@ OPTLYDEF void        optly_error_print(const OptlyErrors *errs);
 
 #if defined(OPTLY_GEN_VERSION_FLAG) || defined(OPTLY_GEN_VERSION_COMMAND)
 OPTLYDEF OptlyErrors optly_parse_args(int argc, char *argv[], OptlyCommand *main_cmd, const char *version);
+OPTLYDEF bool        optly_parse(const OptlyCommand *schema, int argc, char *argv[], OptlyResult *result, const char *version);
+OPTLYDEF bool        optly_parse_line(const OptlyCommand *schema, char *line, char *argv[], size_t capacity, OptlyResult *result, const char *version);
 #else
 OPTLYDEF OptlyErrors optly_parse_args(int argc, char *argv[], OptlyCommand *main_cmd);
+OPTLYDEF bool        optly_parse(const OptlyCommand *schema, int argc, char *argv[], OptlyResult *result);
+OPTLYDEF bool        optly_parse_line(const OptlyCommand *schema, char *line, char *argv[], size_t capacity, OptlyResult *result);
+#endif
+
+typedef struct OptlyArgv {
+  int    argc;
+  char **argv;
+} OptlyArgv;
+
+// Gets every error of batch item `item`. Called from worker threads, so it has to be thread safe.
+typedef void (*OptlyErrorSink)(void *ctx, size_t item, const OptlyError *error);
+
+typedef struct OptlyBatch {
+  OptlyErrorSink on_error;  // Optional
+  void          *ctx;       // For `on_error`
+
+  // Filled by `optly_parse_batch`
+  size_t failed;      // Items with errors
+  double seconds;     // Wall time of whole batch
+  double per_second;  // Items parsed per second
+} OptlyBatch;
+
+OPTLYDEF bool optly_parse_batch(const OptlyCommand *schema, const OptlyArgv *inputs, size_t count, OptlyResult *out, size_t threads, OptlyBatch *batch);
+
+#if defined(OPTLY_GEN_VERSION_FLAG) || defined(OPTLY_GEN_VERSION_COMMAND)
+OPTLYDEF void optly_parser_init(OptlyParser *parser, const OptlyCommand *schema, OptlyResult *result, const char *version);
+#else
+OPTLYDEF void optly_parser_init(OptlyParser *parser, const OptlyCommand *schema, OptlyResult *result);
+#endif
+OPTLYDEF bool optly_parser_feed(OptlyParser *parser, char *token);
+OPTLYDEF bool optly_parser_finish(OptlyParser *parser);
+
+// Arena bytes for state of the longest chain of commands. Positional values,
+// lists and converted values depend on input and come on top of it.
+OPTLYDEF size_t optly_result_size(const OptlyCommand *schema);
+
+OPTLYDEF bool               optly_result_has(const OptlyResultCommand *command, const char *name);
+OPTLYDEF OptlyFlagValue     optly_result_value(const OptlyResultCommand *command, const char *name);
+OPTLYDEF const OptlyValues *optly_result_positional(const OptlyResultCommand *command, const char *name);
+
+// Handle is position of flag or positional in its command. Resolve it once,
+// then every read is a plain load: `cmd.flags[h].value` or `optly_result_flag(res.commands, h)`
+typedef size_t OptlyHandle;
+
+#define OPTLY_NO_HANDLE ((OptlyHandle)-1)
+
+OPTLYDEF OptlyHandle optly_flag_handle(const OptlyCommand *command, const char *name);
+OPTLYDEF OptlyHandle optly_positional_handle(const OptlyCommand *command, const char *name);
+
+static inline OptlyFlagValue optly_result_flag(const OptlyResultCommand *command, OptlyHandle flag) {
+  return command->values[flag];
+}
+
+// Position of selected value in enum values list, or OPTLY_ENUM_NONE
+static inline uint32_t optly_result_enum(const OptlyResultCommand *command, OptlyHandle flag) {
+  char **list     = command->command->flags[flag].value.as_enum;
+  char **selected = command->values[flag].as_enum;
+
+  return list && selected != list ? (uint32_t)(selected - list - 1) : OPTLY_ENUM_NONE;
+}
+
+#define OPTLY_BIT(position)  ((uint64_t)1 << ((position) % 64))
+#define OPTLY_WORD(position) ((position) / 64)
+
+// Value of bool flag from packed words. For hot loops keep `command->bools[h / 64]`
+// and test it against OPTLY_BIT(h)
+static inline bool optly_result_bool(const OptlyResultCommand *command, OptlyHandle flag) {
+  return (command->bools[flag / 64] & OPTLY_BIT(flag)) != 0;
+}
+
+static inline bool optly_result_flag_present(const OptlyResultCommand *command, OptlyHandle flag) {
+  return (command->present[flag / 64] >> (flag % 64)) & 1;
+}
+
+static inline const OptlyValues *optly_result_values(const OptlyResultCommand *command, OptlyHandle positional) {
+  return &command->positionals[positional];
+}
+
+#ifdef OPTLY_RESPONSE_FILES
+typedef struct OptlyResponseFile {
+  void   *addr;    // Private mapping of the file followed by its tokens
+  size_t  size;
+  char  **tokens;  // NULL if file couldn't be read
+  size_t  count;
+} OptlyResponseFile;
+
+// Mappings behind expanded argv. Strings stay valid until `optly_response_files_free`.
+typedef struct OptlyResponseFiles {
+  OptlyResponseFile files[OPTLY_RESPONSE_FILES_MAX];
+  size_t            count;
+
+  char **argv;  // Expanded argv, NULL if there was nothing to expand
+  size_t argv_size;
+} OptlyResponseFiles;
+
+OPTLYDEF bool optly_expand_response_files(int *argc, char ***argv, OptlyResponseFiles *files, OptlyErrors *errs);
+OPTLYDEF void optly_response_files_free(OptlyResponseFiles *files);
+#endif
+
+OPTLYDEF void  *optly_arena_alloc(OptlyArena *arena, size_t size, size_t align);
+OPTLYDEF size_t optly_compile_size(const OptlyCommand *command);
+OPTLYDEF bool   optly_compile(OptlyCommand *command, OptlyArena *arena);
+OPTLYDEF bool   optly_install(OptlyCommand *command, OptlyIndex *const *indexes, size_t count);
+OPTLYDEF uint32_t optly_schema_hash(const OptlyCommand *command);
+
+#ifdef OPTLY_GENERATOR
+OPTLYDEF bool optly_generate(const OptlyCommand *command, const char *prefix, FILE *out);
 #endif
 
 OPTLYDEF bool             optly_is_command(OptlyCommand *command, const char *name);
 OPTLYDEF const OptlyFlag *optly_get_flag(const OptlyFlag *flags, const char *name);
 OPTLYDEF OptlyPositional *optly_get_positional(OptlyCommand *command, const char *name);
 
-OPTLYDEF void optly_usage(OptlyCommand *command);
+OPTLYDEF void   optly_usage(const OptlyCommand *command);
+OPTLYDEF void   optly_usage_to_file(const OptlyCommand *command, FILE *file);
+OPTLYDEF size_t optly_usage_to_buffer(const OptlyCommand *command, char *buf, size_t cap);
 
 static inline bool optly_is_flag_null(const OptlyFlag *flag) {
   return flag == NULL || (flag->fullname == NULL && flag->shortname == 0);
@@ -447,20 +1222,31 @@ static inline bool optly_is_command_null(const OptlyCommand *cmd) {
   return cmd == NULL || cmd->name == NULL;
 }
 
-inline OPTLYDEF bool             optly_flag_value_bool(const OptlyCommand *command, const char *name);
-inline OPTLYDEF char             optly_flag_value_char(const OptlyCommand *command, const char *name);
-inline OPTLYDEF char            *optly_flag_value_string(const OptlyCommand *command, const char *name);
-inline OPTLYDEF int8_t           optly_flag_value_int8(const OptlyCommand *command, const char *name);
-inline OPTLYDEF int16_t          optly_flag_value_int16(const OptlyCommand *command, const char *name);
-inline OPTLYDEF int32_t          optly_flag_value_int32(const OptlyCommand *command, const char *name);
-inline OPTLYDEF int64_t          optly_flag_value_int64(const OptlyCommand *command, const char *name);
-inline OPTLYDEF uint8_t          optly_flag_value_uint8(const OptlyCommand *command, const char *name);
-inline OPTLYDEF uint16_t         optly_flag_value_uint16(const OptlyCommand *command, const char *name);
-inline OPTLYDEF uint32_t         optly_flag_value_uint32(const OptlyCommand *command, const char *name);
-inline OPTLYDEF uint64_t         optly_flag_value_uint64(const OptlyCommand *command, const char *name);
-inline OPTLYDEF float            optly_flag_value_float(const OptlyCommand *command, const char *name);
-inline OPTLYDEF double           optly_flag_value_double(const OptlyCommand *command, const char *name);
-inline OPTLYDEF OptlyPositional *optly_get_positional(OptlyCommand *command, const char *name);
+OPTLYDEF bool             optly_flag_value_bool(const OptlyCommand *command, const char *name);
+OPTLYDEF char             optly_flag_value_char(const OptlyCommand *command, const char *name);
+OPTLYDEF char            *optly_flag_value_string(const OptlyCommand *command, const char *name);
+OPTLYDEF int8_t           optly_flag_value_int8(const OptlyCommand *command, const char *name);
+OPTLYDEF int16_t          optly_flag_value_int16(const OptlyCommand *command, const char *name);
+OPTLYDEF int32_t          optly_flag_value_int32(const OptlyCommand *command, const char *name);
+OPTLYDEF int64_t          optly_flag_value_int64(const OptlyCommand *command, const char *name);
+OPTLYDEF uint8_t          optly_flag_value_uint8(const OptlyCommand *command, const char *name);
+OPTLYDEF uint16_t         optly_flag_value_uint16(const OptlyCommand *command, const char *name);
+OPTLYDEF uint32_t         optly_flag_value_uint32(const OptlyCommand *command, const char *name);
+OPTLYDEF uint64_t         optly_flag_value_uint64(const OptlyCommand *command, const char *name);
+OPTLYDEF float            optly_flag_value_float(const OptlyCommand *command, const char *name);
+OPTLYDEF double           optly_flag_value_double(const OptlyCommand *command, const char *name);
+OPTLYDEF char            *optly_flag_value_enum(const OptlyCommand *command, const char *name);
+OPTLYDEF uint32_t         optly_flag_value_enum_index(const OptlyCommand *command, const char *name);
+OPTLYDEF uint64_t         optly_flag_value_size(const OptlyCommand *command, const char *name);
+OPTLYDEF int64_t          optly_flag_value_duration(const OptlyCommand *command, const char *name);
+OPTLYDEF double           optly_flag_value_rate(const OptlyCommand *command, const char *name);
+OPTLYDEF OptlyCpuSet     *optly_flag_value_cpuset(const OptlyCommand *command, const char *name);
+OPTLYDEF void            *optly_flag_value_custom(const OptlyCommand *command, const char *name);
+OPTLYDEF OptlyList       *optly_flag_value_list(const OptlyCommand *command, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif  // OPTLY_H
 
@@ -469,10 +1255,35 @@ inline OPTLYDEF OptlyPositional *optly_get_positional(OptlyCommand *command, con
 #ifdef OPTLY_IMPLEMENTATION
 
 #include <assert.h>
+#include <errno.h>
+#include <float.h>
+#include <locale.h>
+#include <math.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <time.h>
+
+#ifdef OPTLY_THREADS
+#include <pthread.h>
+#endif
+
+#ifdef OPTLY_RESPONSE_FILES
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#ifndef MAP_ANONYMOUS
+#error "OPTLY_RESPONSE_FILES needs MAP_ANONYMOUS, define _DEFAULT_SOURCE before including headers"
+#endif
+#endif
 
 // Logcie integration
 
@@ -492,8 +1303,6 @@ inline OPTLYDEF OptlyPositional *optly_get_positional(OptlyCommand *command, con
 #endif
 #endif
 
-#define SHIFT_ARG(argv, argc) (++(argv), --(argc))
-
 static const char *error_messages[] = {
   [OPTLY_OK]                      = "No error",
   [OPTLY_ERR_UNKNOWN_FLAG]        = "Unknown flag",
@@ -505,13 +1314,18 @@ static const char *error_messages[] = {
   [OPTLY_ERR_POSITIONAL_TOO_MANY] = "Too many positional arguments",
   [OPTLY_ERR_DUPLICATE_VARIADIC]  = "Duplicate variadic positional",
   [OPTLY_ERR_BATCH_NON_BOOL]      = "Cannot batch non-boolean flags",
+  [OPTLY_ERR_OUT_OF_MEMORY]       = "Not enough memory for parse results",
+  [OPTLY_ERR_RESPONSE_FILE]       = "Can't read response file",
+  [OPTLY_ERR_CONSTRAINT]          = "Flags don't satisfy constraint",
+  [OPTLY_ERR_RESPONSE_FILE_DEPTH] = "Response files are nested too deep",
+  [OPTLY_ERR_UNCLOSED_QUOTE]      = "Quote is not closed",
 };
 
 OPTLYDEF const char *optly_error_message(OptlyErrorKind err) {
 #if __STDC_VERSION__ >= 201112L  // Check for C11 support
-  static_assert(Count_OptlyError == 10, "Forgot to update optly_error_message");
+  static_assert(Count_OptlyError == 15, "Forgot to update optly_error_message");
 #else
-  assert(Count_OptlyError == 10 && "Forgot to update optly_error_message");
+  assert(Count_OptlyError == 15 && "Forgot to update optly_error_message");
 #endif
 
   assert(err >= OPTLY_OK && err < Count_OptlyError);
@@ -549,19 +1363,74 @@ OPTLYDEF OptlyError optly_errors_at(const OptlyErrors *errs, size_t i) {
   return errs->items[i];
 }
 
-static bool optly__has_flags(OptlyCommand *cmd) {
+static bool optly__has_flags(const OptlyCommand *cmd) {
   return cmd && cmd->flags && !optly_is_flag_null(cmd->flags);
 }
 
-static bool optly__has_commands(OptlyCommand *cmd) {
+static bool optly__has_commands(const OptlyCommand *cmd) {
   return cmd && cmd->commands && !optly_is_command_null(cmd->commands);
 }
 
-static bool optly__has_positionals(OptlyCommand *cmd) {
+static bool optly__has_positionals(const OptlyCommand *cmd) {
   return cmd && cmd->positionals && cmd->positionals->name;
 }
 
-static void optly__usage_positionals_signature(OptlyPositional *pos) {
+// NOTE: Usage is rendered into one buffer and written at once, stderr is unbuffered
+//       and every fprintf to it would be a separate write
+typedef struct OptlyUsageWriter {
+  char  *buf;
+  size_t cap;
+  size_t used;   // Bytes waiting in buf
+  size_t total;  // Bytes rendered so far, including flushed and truncated ones
+  FILE  *file;   // Where buf is flushed when it fills up, NULL renders into buf only
+} OptlyUsageWriter;
+
+static void optly__usage_flush(OptlyUsageWriter *w) {
+  if (w->file && w->used) {
+    fwrite(w->buf, 1, w->used, w->file);
+    w->used = 0;
+  }
+}
+
+static void optly__usage_printf(OptlyUsageWriter *w, const char *fmt, ...) {
+  va_list args;
+
+  size_t room = w->cap - w->used;
+  char  *dst  = w->buf ? w->buf + w->used : NULL;
+
+  va_start(args, fmt);
+  int len = vsnprintf(dst, room, fmt, args);
+  va_end(args);
+
+  if (len < 0) return;
+
+  w->total += (size_t)len;
+
+  if ((size_t)len < room) {
+    w->used += (size_t)len;
+    return;
+  }
+
+  if (!w->file) {
+    // NOTE: Truncated like snprintf, vsnprintf already terminated it
+    w->used = room ? w->cap - 1 : w->used;
+    return;
+  }
+
+  optly__usage_flush(w);
+
+  va_start(args, fmt);
+
+  if ((size_t)len < w->cap) {
+    w->used = (size_t)vsnprintf(w->buf, w->cap, fmt, args);
+  } else {
+    vfprintf(w->file, fmt, args);
+  }
+
+  va_end(args);
+}
+
+static void optly__usage_positionals_signature(OptlyUsageWriter *w, const OptlyPositional *pos) {
   if (!pos) return;
 
   for (; pos->name; pos++) {
@@ -569,54 +1438,78 @@ static void optly__usage_positionals_signature(OptlyPositional *pos) {
     bool variadic = pos->max == 0 || pos->max > 1;
 
     if (required)
-      fprintf(stderr, " <%s%s>", pos->name, variadic ? "..." : "");
+      optly__usage_printf(w, " <%s%s>", pos->name, variadic ? "..." : "");
     else
-      fprintf(stderr, " [%s%s]", pos->name, variadic ? "..." : "");
+      optly__usage_printf(w, " [%s%s]", pos->name, variadic ? "..." : "");
   }
 }
 
-static void optly__usage_signature(OptlyCommand *cmd) {
-  fprintf(stderr, "Usage: %s", cmd->name);
+static void optly__usage_signature(OptlyUsageWriter *w, const OptlyCommand *cmd, const char *name) {
+  optly__usage_printf(w, "Usage: %s", name);
 
   if (optly__has_flags(cmd))
-    fprintf(stderr, " [FLAGS]");
+    optly__usage_printf(w, " [FLAGS]");
 
   if (optly__has_positionals(cmd))
-    optly__usage_positionals_signature(cmd->positionals);
+    optly__usage_positionals_signature(w, cmd->positionals);
 
   if (optly__has_commands(cmd))
-    fprintf(stderr, " <COMMAND>");
+    optly__usage_printf(w, " <COMMAND>");
 
-  fprintf(stderr, "\n");
+  optly__usage_printf(w, "\n");
 }
 
-static uint8_t type_name_pad = 8;
-
 static const char *optly__flag_type_name(OptlyFlagType type) {
   switch (type) {
-    case OPTLY_TYPE_BOOL:   return "";
-    case OPTLY_TYPE_CHAR:   return "<char>";
-    case OPTLY_TYPE_STRING: return "<str>";
-    case OPTLY_TYPE_INT8:   return "<i8>";
-    case OPTLY_TYPE_INT16:  return "<i16>";
-    case OPTLY_TYPE_INT32:  return "<i32>";
-    case OPTLY_TYPE_INT64:  return "<i64>";
-    case OPTLY_TYPE_UINT8:  return "<u8>";
-    case OPTLY_TYPE_UINT16: return "<u16>";
-    case OPTLY_TYPE_UINT32: return "<u32>";
-    case OPTLY_TYPE_UINT64: return "<u64>";
-    case OPTLY_TYPE_FLOAT:  return "<float>";
-    case OPTLY_TYPE_DOUBLE: return "<double>";
-    case OPTLY_TYPE_ENUM:   return "<enum>";
+    case OPTLY_TYPE_BOOL:     return "";
+    case OPTLY_TYPE_CHAR:     return "<char>";
+    case OPTLY_TYPE_STRING:   return "<str>";
+    case OPTLY_TYPE_INT8:     return "<i8>";
+    case OPTLY_TYPE_INT16:    return "<i16>";
+    case OPTLY_TYPE_INT32:    return "<i32>";
+    case OPTLY_TYPE_INT64:    return "<i64>";
+    case OPTLY_TYPE_UINT8:    return "<u8>";
+    case OPTLY_TYPE_UINT16:   return "<u16>";
+    case OPTLY_TYPE_UINT32:   return "<u32>";
+    case OPTLY_TYPE_UINT64:   return "<u64>";
+    case OPTLY_TYPE_FLOAT:    return "<float>";
+    case OPTLY_TYPE_DOUBLE:   return "<double>";
+    case OPTLY_TYPE_ENUM:     return "<enum>";
+    case OPTLY_TYPE_SIZE:     return "<size>";
+    case OPTLY_TYPE_DURATION: return "<duration>";
+    case OPTLY_TYPE_RATE:     return "<rate>";
+    case OPTLY_TYPE_CPUSET:   return "<cpus>";
+    case OPTLY_TYPE_CUSTOM:   return "<value>";
   }
 
   return "";
 }
 
-static size_t optly__flag_print_width(OptlyFlag *flags) {
-  size_t max = 0;
-
-  for (OptlyFlag *flag = flags; !optly_is_flag_null(flag); flag++) {
+/**
+ * Room for type name: 8 as always, more only if command has a flag with longer
+ * one, so help of existing commands doesn't move. Enum values don't count.
+ */
+static size_t optly__type_name_width(const OptlyFlag *flags) {
+  size_t max = 8;
+
+  for (const OptlyFlag *flag = flags; !optly_is_flag_null(flag); flag++) {
+    const char *name = flag->type == OPTLY_TYPE_CUSTOM && flag->converter && flag->converter->type_name
+                         ? flag->converter->type_name
+                         : optly__flag_type_name(flag->type);
+    size_t      len  = flag->type == OPTLY_TYPE_ENUM ? 0 : strlen(name) + (flag->list ? 3 : 0);
+
+    if (len > max) {
+      max = len;
+    }
+  }
+
+  return max;
+}
+
+static size_t optly__flag_print_width(const OptlyFlag *flags) {
+  size_t max = 0;
+
+  for (const OptlyFlag *flag = flags; !optly_is_flag_null(flag); flag++) {
     size_t len = 0;
 
     if (flag->shortname) {
@@ -635,34 +1528,108 @@ static size_t optly__flag_print_width(OptlyFlag *flags) {
   return max;
 }
 
-static void optly__print_default_value(OptlyFlag *flag) {
+static void optly__print_size(OptlyUsageWriter *w, uint64_t size) {
+  static const char *units[] = {"B", "KiB", "MiB", "GiB", "TiB", "PiB", "EiB"};
+
+  size_t unit = 0;
+
+  while (size != 0 && size % 1024 == 0 && unit < 6) {
+    size /= 1024;
+    unit++;
+  }
+
+  optly__usage_printf(w, "%llu%s", (unsigned long long)size, units[unit]);
+}
+
+static void optly__print_duration(OptlyUsageWriter *w, int64_t duration) {
+  static const struct {
+    const char *name;
+    uint64_t    ns;
+  } units[] = {{"d", 86400000000000}, {"h", 3600000000000}, {"m", 60000000000}, {"s", 1000000000}, {"ms", 1000000}, {"us", 1000}, {"ns", 1}};
+
+  uint64_t left = duration < 0 ? 0 - (uint64_t)duration : (uint64_t)duration;
+
+  if (left == 0) {
+    optly__usage_printf(w, "0s");
+    return;
+  }
+
+  if (duration < 0) {
+    optly__usage_printf(w, "-");
+  }
+
+  for (size_t i = 0; i < sizeof(units) / sizeof(*units); i++) {
+    if (left >= units[i].ns) {
+      optly__usage_printf(w, "%llu%s", (unsigned long long)(left / units[i].ns), units[i].name);
+      left %= units[i].ns;
+    }
+  }
+}
+
+static void optly__print_cpuset(OptlyUsageWriter *w, const OptlyCpuSet *set) {
+  const char *sep = "";
+
+  if (!set) {
+    optly__usage_printf(w, "none");
+    return;
+  }
+
+  for (size_t cpu = 0; cpu < OPTLY_MAX_CPUS; cpu++) {
+    if (!optly_cpuset_has(set, cpu)) continue;
+
+    size_t last = cpu;
+    while (optly_cpuset_has(set, last + 1)) last++;
+
+    if (last == cpu) {
+      optly__usage_printf(w, "%s%zu", sep, cpu);
+    } else {
+      optly__usage_printf(w, "%s%zu-%zu", sep, cpu, last);
+    }
+
+    sep = ",";
+    cpu = last;
+  }
+}
+
+static void optly__print_default_value(OptlyUsageWriter *w, const OptlyFlag *flag) {
   if (flag->type == OPTLY_TYPE_BOOL) return;
 
-  fprintf(stderr, " (default: ");
+  optly__usage_printf(w, " (default: ");
 
   switch (flag->type) {
-    case OPTLY_TYPE_CHAR:   fprintf(stderr, "%c", flag->value.as_char); break;
-    case OPTLY_TYPE_STRING: fprintf(stderr, "%s", flag->value.as_string); break;
-    case OPTLY_TYPE_INT8:   fprintf(stderr, "%d", flag->value.as_int8); break;
-    case OPTLY_TYPE_INT16:  fprintf(stderr, "%d", flag->value.as_int16); break;
-    case OPTLY_TYPE_INT32:  fprintf(stderr, "%d", flag->value.as_int32); break;
-    case OPTLY_TYPE_INT64:  fprintf(stderr, "%lld", (long long)flag->value.as_int64); break;
-    case OPTLY_TYPE_UINT8:  fprintf(stderr, "%u", flag->value.as_uint8); break;
-    case OPTLY_TYPE_UINT16: fprintf(stderr, "%u", flag->value.as_uint16); break;
-    case OPTLY_TYPE_UINT32: fprintf(stderr, "%u", flag->value.as_uint32); break;
-    case OPTLY_TYPE_UINT64: fprintf(stderr, "%llu", (unsigned long long)flag->value.as_uint64); break;
-    case OPTLY_TYPE_FLOAT:  fprintf(stderr, "%f", flag->value.as_float); break;
-    case OPTLY_TYPE_DOUBLE: fprintf(stderr, "%f", flag->value.as_double); break;
-    default:                break;
+    case OPTLY_TYPE_CHAR:   optly__usage_printf(w, "%c", flag->value.as_char); break;
+    case OPTLY_TYPE_STRING: optly__usage_printf(w, "%s", flag->value.as_string); break;
+    case OPTLY_TYPE_INT8:   optly__usage_printf(w, "%d", flag->value.as_int8); break;
+    case OPTLY_TYPE_INT16:  optly__usage_printf(w, "%d", flag->value.as_int16); break;
+    case OPTLY_TYPE_INT32:  optly__usage_printf(w, "%d", flag->value.as_int32); break;
+    case OPTLY_TYPE_INT64:  optly__usage_printf(w, "%lld", (long long)flag->value.as_int64); break;
+    case OPTLY_TYPE_UINT8:  optly__usage_printf(w, "%u", flag->value.as_uint8); break;
+    case OPTLY_TYPE_UINT16: optly__usage_printf(w, "%u", flag->value.as_uint16); break;
+    case OPTLY_TYPE_UINT32: optly__usage_printf(w, "%u", flag->value.as_uint32); break;
+    case OPTLY_TYPE_UINT64: optly__usage_printf(w, "%llu", (unsigned long long)flag->value.as_uint64); break;
+    case OPTLY_TYPE_FLOAT:  optly__usage_printf(w, "%f", flag->value.as_float); break;
+    case OPTLY_TYPE_DOUBLE: optly__usage_printf(w, "%f", flag->value.as_double); break;
+
+    case OPTLY_TYPE_SIZE:     optly__print_size(w, flag->value.as_uint64); break;
+    case OPTLY_TYPE_DURATION: optly__print_duration(w, flag->value.as_int64); break;
+    case OPTLY_TYPE_RATE:     optly__usage_printf(w, "%g/s", flag->value.as_double); break;
+    case OPTLY_TYPE_CPUSET:   optly__print_cpuset(w, flag->value.as_cpuset); break;
+    case OPTLY_TYPE_CUSTOM:   {
+      char buf[OPTLY_FLAG_BUFFER_LENGTH] = {0};
+      flag->converter->format(flag, flag->value.as_custom, buf, sizeof(buf));
+      optly__usage_printf(w, "%s", buf);
+      break;
+    }
+    default:                  break;
   }
 
-  fprintf(stderr, ")");
+  optly__usage_printf(w, ")");
 }
 
-static size_t optly__command_print_width(OptlyCommand *commands) {
+static size_t optly__command_print_width(const OptlyCommand *commands) {
   size_t max = 0;
 
-  for (OptlyCommand *cmd = commands; !optly_is_command_null(cmd); cmd++) {
+  for (const OptlyCommand *cmd = commands; !optly_is_command_null(cmd); cmd++) {
     size_t len = strlen(cmd->name);
 
     if (len > max) {
@@ -673,637 +1640,3414 @@ static size_t optly__command_print_width(OptlyCommand *commands) {
   return max;
 }
 
-static void optly__usage_commands_list(OptlyCommand *commands) {
+static void optly__usage_commands_list(OptlyUsageWriter *w, const OptlyCommand *commands) {
   if (!commands) return;
 
-  fprintf(stderr, "\nCOMMANDS\n");
+  optly__usage_printf(w, "\nCOMMANDS\n");
   size_t pad = optly__command_print_width(commands);
 
-  for (OptlyCommand *cmd = commands; !optly_is_command_null(cmd); cmd++) {
-    fprintf(stderr, "  %-*s  %s\n", (int)pad, cmd->name, cmd->description ? cmd->description : "");
+  for (const OptlyCommand *cmd = commands; !optly_is_command_null(cmd); cmd++) {
+    optly__usage_printf(w, "  %-*s  %s\n", (int)pad, cmd->name, cmd->description ? cmd->description : "");
   }
 
 #ifdef OPTLY_GEN_HELP_COMMAND
-  fprintf(stderr, "  %-*s  %s\n", (int)pad, "help", "Show help for command");
+  optly__usage_printf(w, "  %-*s  %s\n", (int)pad, "help", "Show help for command");
 #endif
 
 #ifdef OPTLY_GEN_VERSION_COMMAND
-  fprintf(stderr, "  %-*s  %s\n", (int)pad, "version", "Show app version");
+  optly__usage_printf(w, "  %-*s  %s\n", (int)pad, "version", "Show app version");
 #endif
 }
 
-static void optly__usage_flags(OptlyFlag *flags) {
-  if (!flags) return;
+static void optly__usage_flag(OptlyUsageWriter *w, const OptlyFlag *flag, size_t pad) {
+  char buf[OPTLY_FLAG_BUFFER_LENGTH + 16];
 
-  fprintf(stderr, "\nFLAGS\n");
+  // const char *type = optly__flag_type_name(flag->type);
+  char type_buf[OPTLY_FLAG_BUFFER_LENGTH];
 
-  size_t pad = optly__flag_print_width(flags);
+  if (flag->type == OPTLY_TYPE_ENUM && flag->value.as_enum) {
+    char **vals = flag->value.as_enum;
 
-  for (OptlyFlag *flag = flags; !optly_is_flag_null(flag); flag++) {
-    char buf[OPTLY_FLAG_BUFFER_LENGTH + 16];
+    size_t offset = 0;
+    offset += snprintf(type_buf + offset, sizeof(type_buf) - offset, "[");
 
-    // const char *type = optly__flag_type_name(flag->type);
-    char type_buf[OPTLY_FLAG_BUFFER_LENGTH];
+    for (char **v = vals + 1; *v; v++) {
+      offset += snprintf(type_buf + offset, sizeof(type_buf) - offset, "%s", *v);
+      if (*(v + 1)) {
+        offset += snprintf(type_buf + offset, sizeof(type_buf) - offset, "|");
+      }
+    }
 
-    if (flag->type == OPTLY_TYPE_ENUM && flag->value.as_enum) {
-      char **vals = flag->value.as_enum;
+    snprintf(type_buf + offset, sizeof(type_buf) - offset, "]");
+  } else if (flag->type == OPTLY_TYPE_CUSTOM && flag->converter && flag->converter->type_name) {
+    snprintf(type_buf, sizeof(type_buf), "%s", flag->converter->type_name);
+  } else {
+    snprintf(type_buf, sizeof(type_buf), "%s", optly__flag_type_name(flag->type));
+  }
 
-      size_t offset = 0;
-      offset += snprintf(type_buf + offset, sizeof(type_buf) - offset, "[");
+  if (flag->list) {
+    size_t len = strlen(type_buf);
+    snprintf(type_buf + len, sizeof(type_buf) - len, "...");
+  }
 
-      for (char **v = vals + 1; *v; v++) {
-        offset += snprintf(type_buf + offset, sizeof(type_buf) - offset, "%s", *v);
-        if (*(v + 1)) {
-          offset += snprintf(type_buf + offset, sizeof(type_buf) - offset, "|");
-        }
-      }
+  const char *type = type_buf;
 
-      snprintf(type_buf + offset, sizeof(type_buf) - offset, "]");
-    } else {
-      snprintf(type_buf, sizeof(type_buf), "%s", optly__flag_type_name(flag->type));
-    }
+  if (flag->shortname && flag->fullname) {
+    snprintf(buf, sizeof(buf), "-%c --%s %s", flag->shortname, flag->fullname, type);
+  } else if (flag->fullname) {
+    snprintf(buf, sizeof(buf), "--%s %s", flag->fullname, type);
+  } else {
+    snprintf(buf, sizeof(buf), "-%c %s", flag->shortname, type);
+  }
 
-    const char *type = type_buf;
+  optly__usage_printf(w, "  %-*s  %s", (int)pad, buf, flag->description ? flag->description : "");
 
-    if (flag->shortname && flag->fullname) {
-      snprintf(buf, sizeof(buf), "-%c --%s %s", flag->shortname, flag->fullname, type);
-    } else if (flag->fullname) {
-      snprintf(buf, sizeof(buf), "--%s %s", flag->fullname, type);
-    } else {
-      snprintf(buf, sizeof(buf), "-%c %s", flag->shortname, type);
+  if (flag->required) {
+    optly__usage_printf(w, " (required)");
+  } else if (flag->list) {
+    // NOTE: Defaults of list are not shown
+  } else if (flag->type == OPTLY_TYPE_ENUM && flag->value.as_enum) {
+    if (flag->value.as_enum[0]) {
+      optly__usage_printf(w, " (default: %s)", flag->value.as_enum[0]);
     }
+  } else if (flag->type == OPTLY_TYPE_CUSTOM && !(flag->converter && flag->converter->format)) {
+    // NOTE: Nothing knows how to show it
+  } else if (flag->value.as_string != NULL) {
+    optly__print_default_value(w, flag);
+  }
 
-    fprintf(stderr, "  %-*s  %s", (int)pad + type_name_pad, buf, flag->description ? flag->description : "");
+  optly__usage_printf(w, "\n");
+}
 
-    if (flag->required) {
-      fprintf(stderr, " (required)");
-    } else if (flag->type == OPTLY_TYPE_ENUM && flag->value.as_enum) {
-      if (flag->value.as_enum[0]) {
-        fprintf(stderr, " (default: %s)", flag->value.as_enum[0]);
-      }
-    } else if (flag->value.as_string != NULL) {
-      optly__print_default_value(flag);
-    }
+static void optly__usage_flags(OptlyUsageWriter *w, const OptlyFlag *flags) {
+  if (!flags) return;
+
+  optly__usage_printf(w, "\nFLAGS\n");
 
-    fprintf(stderr, "\n");
+  size_t pad = optly__flag_print_width(flags) + optly__type_name_width(flags);
+
+  for (const OptlyFlag *flag = flags; !optly_is_flag_null(flag); flag++) {
+    optly__usage_flag(w, flag, pad);
   }
 
 #ifdef OPTLY_GEN_HELP_FLAG
-  fprintf(stderr, "\n  %-*s  Show this message\n", (int)pad + type_name_pad, "-h --help");
+  optly__usage_printf(w, "\n  %-*s  Show this message\n", (int)pad, "-h --help");
 #endif
 
 #ifdef OPTLY_GEN_VERSION_FLAG
-  fprintf(stderr, "  %-*s  Show version\n", (int)pad + type_name_pad, "-v --version");
+  optly__usage_printf(w, "  %-*s  Show version\n", (int)pad, "-v --version");
 #endif
 }
 
-static void optly__usage_positionals(OptlyPositional *pos) {
+static void optly__usage_positionals(OptlyUsageWriter *w, const OptlyPositional *pos) {
   if (!pos) return;
 
-  fprintf(stderr, "\nPOSITIONAL ARGUMENTS\n");
+  optly__usage_printf(w, "\nPOSITIONAL ARGUMENTS\n");
 
   for (; pos->name; pos++) {
     if (pos->max == 0) {
-      fprintf(stderr, "  %s  (%zu.. values)\n", pos->name, pos->min);
+      optly__usage_printf(w, "  %s  (%zu.. values)\n", pos->name, pos->min);
     } else {
-      fprintf(stderr, "  %s  (%zu..%zu values)\n", pos->name, pos->min, pos->max);
+      optly__usage_printf(w, "  %s  (%zu..%zu values)\n", pos->name, pos->min, pos->max);
     }
   }
 }
 
-OPTLYDEF void optly_usage(OptlyCommand *command) {
+static void optly__usage_render(OptlyUsageWriter *w, const OptlyCommand *command, const char *name) {
   if (command->description) {
-    fprintf(stderr, "%s\n\n", command->description);
+    optly__usage_printf(w, "%s\n\n", command->description);
   }
 
-  optly__usage_signature(command);
+  optly__usage_signature(w, command, name);
 
-  optly__usage_commands_list(command->commands);
-  optly__usage_positionals(command->positionals);
-  optly__usage_flags(command->flags);
+  optly__usage_commands_list(w, command->commands);
+  optly__usage_positionals(w, command->positionals);
+  optly__usage_flags(w, command->flags);
 
 #ifdef OPTLY_GET_HELP_COMMAND
-  fprintf(stderr, "\nRun '%s help <command>' for more information.\n", command->name);
+  optly__usage_printf(w, "\nRun '%s help <command>' for more information.\n", name);
 #endif
 }
 
 /**
- * Check if argument matches a flag definition.
+ * Render usage, or take text generated for the command if it is shown under its own name.
  */
-static bool optly__flag_matches(const char *arg, const OptlyFlag *flag) {
-  bool is_short = arg[1] != '-';
+static void optly__usage_write(OptlyUsageWriter *w, const OptlyCommand *command, const char *name) {
+  if (command->index && command->index->usage && command->name && strcmp(command->name, name) == 0) {
+    optly__usage_printf(w, "%s", command->index->usage);
+  } else {
+    optly__usage_render(w, command, name);
+  }
+}
 
-  return (!is_short && strcmp(arg + 2, flag->fullname) == 0) ||
-         (is_short && (arg[1] == flag->shortname));
+static void optly__usage(const OptlyCommand *command, const char *name, FILE *file) {
+  char             buf[OPTLY_USAGE_BUFFER_LENGTH];
+  OptlyUsageWriter w = {buf, sizeof(buf), 0, 0, file};
+
+  optly__usage_write(&w, command, name);
+  optly__usage_flush(&w);
 }
 
-/**
- * Find a flag by argument.
- */
-static OptlyFlag *optly__find_flag(const char *arg, OptlyFlag *flags) {
-  for (OptlyFlag *f = flags; !optly_is_flag_null(f); f++) {
-    if (optly__flag_matches(arg, f)) {
-      return f;
-    }
-  }
+OPTLYDEF void optly_usage(const OptlyCommand *command) {
+  optly__usage(command, command->name, stderr);
+}
 
-  return NULL;
+OPTLYDEF void optly_usage_to_file(const OptlyCommand *command, FILE *file) {
+  optly__usage(command, command->name, file);
 }
 
-static void optly__flag_set_value(OptlyFlag *flag, char *value, OptlyErrors *errs) {
-  assert(flag);
+OPTLYDEF size_t optly_usage_to_buffer(const OptlyCommand *command, char *buf, size_t cap) {
+  OptlyUsageWriter w = {buf, cap, 0, 0, NULL};
 
-  if (flag->type != OPTLY_TYPE_BOOL && !value) {
-    OPTLY_LOG(FATAL, "Flag --%s requires value", flag->fullname);
-    optly__push_error(errs, OPTLY_ERR_MISSING_VALUE, flag->fullname);
-    return;
+  if (cap) {
+    buf[0] = '\0';
   }
 
-  if (flag->type != OPTLY_TYPE_ENUM) {
-    flag->value.as_int64 = 0;
-  }
+  optly__usage_write(&w, command, command->name);
+  return w.total;
+}
 
-  char *end = "";
+OPTLYDEF void *optly_arena_alloc(OptlyArena *arena, size_t size, size_t align) {
+  assert(arena && align && (align & (align - 1)) == 0);
 
-  switch (flag->type) {
-    case OPTLY_TYPE_CHAR:   flag->value.as_char = *value; break;
-    case OPTLY_TYPE_STRING: flag->value.as_string = value; break;
-    case OPTLY_TYPE_INT8:   flag->value.as_int8 = strtoll(value, &end, 10); break;
-    case OPTLY_TYPE_INT16:  flag->value.as_int16 = strtoll(value, &end, 10); break;
-    case OPTLY_TYPE_INT32:  flag->value.as_int32 = strtoll(value, &end, 10); break;
-    case OPTLY_TYPE_INT64:  flag->value.as_int64 = strtoll(value, &end, 10); break;
-    case OPTLY_TYPE_UINT8:  flag->value.as_uint8 = strtoull(value, &end, 10); break;
-    case OPTLY_TYPE_UINT16: flag->value.as_uint16 = strtoull(value, &end, 10); break;
-    case OPTLY_TYPE_UINT32: flag->value.as_uint32 = strtoull(value, &end, 10); break;
-    case OPTLY_TYPE_UINT64: flag->value.as_uint64 = strtoull(value, &end, 10); break;
-    case OPTLY_TYPE_FLOAT:  flag->value.as_float = strtof(value, &end); break;
-    case OPTLY_TYPE_DOUBLE: flag->value.as_double = strtod(value, &end); break;
-    case OPTLY_TYPE_BOOL:   flag->value.as_bool = true; break;
-    case OPTLY_TYPE_ENUM:   {
-      char **vals  = flag->value.as_enum;
-      bool   valid = false;
-
-      for (char **v = vals + 1; *v; v++) {
-        if (strcmp(*v, value) == 0) {
-          valid = true;
-          break;
-        }
-      }
+  size_t pad   = (size_t)(-(uintptr_t)(arena->base + arena->used)) & (align - 1);
+  size_t start = arena->used + pad;
 
-      if (!valid) {
-        OPTLY_LOG(ERROR, "Invalid enum value '%s' for --%s", value, flag->fullname);
-        optly__push_error(errs, OPTLY_ERR_INVALID_VALUE, value);
-        return;
-      }
+  if (start > arena->size || size > arena->size - start) {
+    if (!arena->grow || size > SIZE_MAX - align || !arena->grow(arena, size + align - 1)) {
+      return NULL;
+    }
 
-      flag->value.as_enum[0] = value;
-      break;
+    pad   = (size_t)(-(uintptr_t)(arena->base + arena->used)) & (align - 1);
+    start = arena->used + pad;
+
+    if (start > arena->size || size > arena->size - start) {
+      return NULL;
     }
   }
 
-  if (*end != '\0') {
-    OPTLY_LOG(ERROR, "Argument '%s' is not a number (%s)", flag->fullname, value);
-    optly__push_error(errs, OPTLY_ERR_INVALID_VALUE, value);
-    return;
-  }
+  arena->used = start + size;
+  return arena->base + start;
+}
 
-  flag->present = true;
+static inline bool optly__bit(const uint64_t *bits, size_t i) {
+  return (bits[i / 64] >> (i % 64)) & 1;
 }
 
-inline static bool optly__is_help_flag(char *arg) {
-  return strcmp(arg, "--help") == 0 ||
-         strcmp(arg, OPTLY_HELP_SHORT_FLAG) == 0 ||
-         (strlen(arg) > 2 &&
-          arg[0] == '-' &&
-          arg[1] != '-' &&
-          strchr(arg, OPTLY_HELP_SHORT_FLAG[1]) != NULL);
+static inline void optly__set_bit(uint64_t *bits, size_t i) {
+  bits[i / 64] |= (uint64_t)1 << (i % 64);
 }
 
-inline static bool optly__is_version_flag(char *arg) {
-  return strcmp(arg, "--version") == 0 ||
-         strcmp(arg, OPTLY_VERSION_SHORT_FLAG) == 0 ||
-         (strlen(arg) > 2 &&
-          arg[0] == '-' &&
-          arg[1] != '-' &&
-          strchr(arg, OPTLY_VERSION_SHORT_FLAG[1]) != NULL);
+static inline uint32_t optly__hash_byte(uint32_t hash, unsigned char byte) {
+  return (hash ^ byte) * 16777619u;
 }
 
-static void optly__parse_batch_flags(char *arg, OptlyFlag *flags, OptlyErrors *errs) {
-  if (strchr(arg, '=') != NULL) {
-    return;
+static uint32_t optly__hash(const char *str, size_t len) {
+  uint32_t hash = 2166136261u;  // FNV-1a
+
+  for (size_t i = 0; i < len; i++) {
+    hash = optly__hash_byte(hash, (unsigned char)str[i]);
   }
 
-  for (char *c = &arg[1]; *c; c++) {
-    char sarg[3];
-    snprintf(sarg, sizeof(sarg), "-%c", *c);
+  return hash;
+}
 
-    OptlyFlag *flag = optly__find_flag(sarg, flags);
+static size_t optly__flags_count(const OptlyFlag *flags) {
+  size_t count = 0;
 
-    if (!flag) {
-      OPTLY_LOG(WARN, "Unknown short flag: %s", sarg);
-      optly__push_error(errs, OPTLY_ERR_UNKNOWN_FLAG, sarg);
+  for (const OptlyFlag *flag = flags; !optly_is_flag_null(flag); flag++) {
+    count++;
+  }
 
-      continue;
-    }
+  return count;
+}
 
-    if (flag->type != OPTLY_TYPE_BOOL) {
-      OPTLY_LOG(WARN, "cannot batch non-boolean flags (invalid flag in %s)", sarg);
-      optly__push_error(errs, OPTLY_ERR_BATCH_NON_BOOL, &flag->shortname);
-      continue;
-    }
+/**
+ * Long name table keeps load factor at or below 1/2 so probes stay short.
+ */
+static size_t optly__index_table_size(size_t count) {
+  size_t size = 8;
 
-    flag->value.as_bool = true;
-    flag->present       = true;
+  while (size < count * 2) {
+    size <<= 1;
   }
 
-  return;
+  return size;
 }
 
-static void optly__parse_long_flags(char ***argv_ptr, int *argc_ptr, OptlyFlag *flags, OptlyErrors *errs) {
-  char **argv = *argv_ptr;
-  int    argc = *argc_ptr;
+static size_t optly__commands_count(const OptlyCommand *commands) {
+  size_t count = 0;
 
-  if (!argv || argc <= 0 || !*argv) {
-    return;
+  for (const OptlyCommand *cmd = commands; !optly_is_command_null(cmd); cmd++) {
+    count++;
   }
 
-  char *arg = *argv;
-
-  char *value = NULL;
-  char *eq    = strchr(arg, '=');
-  char  tmp[OPTLY_FLAG_BUFFER_LENGTH];
+  return count;
+}
 
-  if (eq) {
-    size_t len = strlen(arg);
+static size_t optly__enum_count(const OptlyFlag *flag) {
+  size_t count = 0;
 
-    if (len >= sizeof(tmp)) {
-      len = sizeof(tmp) - 1;
+  if (flag->type == OPTLY_TYPE_ENUM && flag->value.as_enum) {
+    for (char **v = flag->value.as_enum + 1; *v; v++) {
+      count++;
     }
-
-    memcpy(tmp, arg, len);
-
-    tmp[len]  = '\0';
-    char *eq2 = strchr(tmp, '=');
-    *eq2      = '\0';
-
-    arg   = tmp;
-    value = eq + 1;
   }
 
-  OptlyFlag *flag = optly__find_flag(arg, flags);
+  return count;
+}
 
-  if (!flag) {
-    OPTLY_LOG(WARN, "Unknown flag: %s", arg);
-    // NOTE: We can't save arg for later because it can point to local tmp (if arg was in form --flag=value)
-    optly__push_error(errs, OPTLY_ERR_UNKNOWN_FLAG, *argv);
-    return;
-  }
+static size_t optly__enums_size(const OptlyCommand *cmd, size_t flags) {
+  size_t size = 0;
 
-  flag->present = true;
+  for (size_t i = 0; i < flags; i++) {
+    size_t count = optly__enum_count(&cmd->flags[i]);
 
-  if (!value && flag->type != OPTLY_TYPE_BOOL && argv[1] && argv[1][0] != '-') {
-    value = argv[1];
-    SHIFT_ARG(argv, argc);
+    if (count >= OPTLY_ENUM_INDEX_MIN) {
+      size += optly__index_table_size(count) * sizeof(OptlyIndexSlot) + OPTLY_ALIGNOF(OptlyIndexSlot);
+    }
   }
 
-  optly__flag_set_value(flag, value, errs);
-
-  *argv_ptr = argv;
-  *argc_ptr = argc;
+  return size ? size + flags * sizeof(OptlyIndexTable) + OPTLY_ALIGNOF(OptlyIndexTable) : 0;
 }
 
-/**
- * Parse flags from argv.
- */
-static void optly__parse_flags(char ***argv_ptr, int *argc_ptr, OptlyFlag *flags, OptlyErrors *errs) {
-  char **argv = *argv_ptr;
-  int    argc = *argc_ptr;
+static size_t optly__groups_count(const OptlyGroup *groups) {
+  size_t count = 0;
 
-  if (!argv || argc <= 0 || !*argv) {
-    return;
+  for (const OptlyGroup *g = groups; g && g->flags; g++) {
+    count++;
   }
 
-  char *arg = *argv;
-
-  bool is_batch_short = (arg[0] == '-' && arg[1] != '-' && strlen(arg) > 2) && arg[2] != '=';
-
-  if (is_batch_short) {
-    optly__parse_batch_flags(arg, flags, errs);
-  } else {
-    optly__parse_long_flags(argv_ptr, argc_ptr, flags, errs);
-  }
+  return count;
 }
 
 /**
- * Parse a command from argv.
+ * Words in one flag bitmask, same as in `OptlyResultCommand.present`.
  */
-static OptlyCommand *optly__parse_command(const char *arg, OptlyCommand *commands) {
-  for (OptlyCommand *cmd = commands; !optly_is_command_null(cmd); cmd++) {
-    if (strcmp(arg, cmd->name) == 0) {
-      return cmd;
-    }
-  }
-
-  return NULL;
+static size_t optly__mask_words(const OptlyCommand *cmd) {
+  return ((cmd->flags ? optly__flags_count(cmd->flags) : 0) + 63) / 64;
 }
 
-static void optly__push_positional(OptlyCommand *cmd, char *value) {
-  if (!cmd->positionals) return;
-  size_t pos_count = 0;
+static size_t optly__masks_size(const OptlyCommand *cmd) {
+  return (1 + 2 * optly__groups_count(cmd->groups)) * optly__mask_words(cmd) * sizeof(uint64_t);
+}
 
-  for (OptlyPositional *p = cmd->positionals; p->name; p++) {
-    pos_count++;
+/**
+ * Masks are: required flags, then members and trigger (first flag of REQUIRES
+ * group, which is not a member) of every group. False if group names unknown flag.
+ */
+static bool optly__build_masks(const OptlyCommand *cmd, uint64_t *masks) {
+  size_t words = optly__mask_words(cmd);
 
-    // Ensure at least 1 arg in optioanl positional
-    size_t min = p->min == 0 ? 1 : p->min;
+  memset(masks, 0, optly__masks_size(cmd));
 
-    if (p->count < min) {
-      p->values[p->count++] = value;
-      return;
+  for (size_t i = 0; cmd->flags && !optly_is_flag_null(&cmd->flags[i]); i++) {
+    if (cmd->flags[i].required) {
+      optly__set_bit(masks, i);
     }
   }
 
-  OptlyPositional *last_p         = &cmd->positionals[pos_count - 1];
-  last_p->values[last_p->count++] = value;
-
-  for (size_t i = pos_count - 1; i > 1; i--) {
-    OptlyPositional *p      = &cmd->positionals[i];
-    OptlyPositional *p_prev = &cmd->positionals[i - 1];
+  for (size_t g = 0; cmd->groups && cmd->groups[g].flags; g++) {
+    uint64_t *members = masks + (1 + 2 * g) * words;
+    uint64_t *trigger = members + words;
 
-    if (p->count > p->max && p->max != 0) {
-      p_prev->values[p_prev->count++] = p->values[0];
+    for (const char **name = cmd->groups[g].flags; *name; name++) {
+      const OptlyFlag *flag = cmd->flags ? optly_get_flag(cmd->flags, *name) : NULL;
 
-      for (size_t i = 0; i < p->count - 1; i++) {
-        p->values[i] = p->values[i + 1];
+      if (!flag) {
+        OPTLY_LOG(FATAL, "Constraint group of '%s' refers to unknown flag '--%s'", cmd->name, *name);
+        return false;
       }
 
-      p->count--;
+      bool first = name == cmd->groups[g].flags;
+      optly__set_bit(first && cmd->groups[g].kind == OPTLY_GROUP_REQUIRES ? trigger : members, (size_t)(flag - cmd->flags));
     }
   }
-}
 
-static void optly__validate_flags(OptlyCommand *cmd, OptlyErrors *errs) {
-  for (OptlyFlag *flag = cmd->flags; !optly_is_flag_null(flag); flag++) {
-    if (flag->required && !flag->present) {
-      OPTLY_LOG(ERROR, "Required flag '--%s' is not present", flag->fullname);
-      optly__push_error(errs, OPTLY_ERR_MISSING_REQUIRED, flag->fullname);
-    }
-  }
+  return true;
 }
 
-static void optly__validate_positionals(OptlyCommand *cmd, OptlyErrors *errs) {
-  if (!cmd->positionals) {
-    return;
-  }
+static size_t optly__index_size(const OptlyCommand *cmd) {
+  size_t flags    = cmd->flags ? optly__flags_count(cmd->flags) : 0;
+  size_t commands = cmd->commands ? optly__commands_count(cmd->commands) : 0;
 
-  bool infinite_found = false;
+  return sizeof(OptlyIndex) + OPTLY_ALIGNOF(OptlyIndex) +
+         optly__index_table_size(flags) * sizeof(OptlyIndexSlot) + OPTLY_ALIGNOF(OptlyIndexSlot) +
+         optly__index_table_size(commands) * sizeof(OptlyIndexSlot) + OPTLY_ALIGNOF(OptlyIndexSlot) +
+         optly__enums_size(cmd, flags) + optly__masks_size(cmd) + OPTLY_ALIGNOF(uint64_t);
+}
 
-  for (OptlyPositional *pos = cmd->positionals; pos->name; pos++) {
-    if (pos->max == 0) {
-      if (infinite_found) {
-        OPTLY_LOG(FATAL, "Positional '%s' allows infinite values, but another variadic positional already exists", pos->name);
-        optly__push_error(errs, OPTLY_ERR_DUPLICATE_VARIADIC, pos->name);
-        OPTLY_EXIT(&errs, OPTLY_ERR_DUPLICATE_VARIADIC);
-      }
+OPTLYDEF size_t optly_compile_size(const OptlyCommand *command) {
+  size_t size = optly__index_size(command);
 
-      infinite_found = true;
+  for (const OptlyCommand *cmd = command->commands; !optly_is_command_null(cmd); cmd++) {
+    // NOTE: Provided subtrees are compiled by provider itself when they are needed
+    if (!cmd->provider) {
+      size += optly_compile_size(cmd);
     }
+  }
 
-    if (pos->count < pos->min) {
-      OPTLY_LOG(ERROR, "Not enough values for positional '%s'", pos->name);
-      optly__push_error(errs, OPTLY_ERR_POSITIONAL_TOO_FEW, pos->name);
-    }
+  return size;
+}
 
-    if (pos->max != 0 && pos->count > pos->max) {
-      OPTLY_LOG(ERROR, "Too many values for positional '%s'", pos->name);
-      optly__push_error(errs, OPTLY_ERR_POSITIONAL_TOO_MANY, pos->name);
-    }
+static OptlyIndexSlot *optly__index_table(OptlyArena *arena, size_t size) {
+  OptlyIndexSlot *slots = optly_arena_alloc(arena, size * sizeof(*slots), OPTLY_ALIGNOF(OptlyIndexSlot));
+
+  if (slots) {
+    memset(slots, 0, size * sizeof(*slots));
   }
-}
 
-inline OPTLYDEF bool optly_is_command(OptlyCommand *command, const char *name) {
-  return command && strcmp(command->name, name) == 0;
+  return slots;
 }
 
-const OptlyFlag *optly_get_flag(const OptlyFlag *flags, const char *name) {
-  for (const OptlyFlag *flag = flags; !optly_is_flag_null(flag); flag++) {
-    if (strcmp(flag->fullname, name) == 0) {
-      return flag;
+/**
+ * Find `len` bytes of name, which don't have to be NUL terminated.
+ */
+static const OptlyIndexSlot *optly__index_find(const OptlyIndexSlot *slots, size_t mask, const char *name, size_t len) {
+  uint32_t hash = optly__hash(name, len);
+
+  for (size_t slot = hash & mask; slots[slot].index; slot = (slot + 1) & mask) {
+    if (slots[slot].hash == hash && slots[slot].len == len && memcmp(slots[slot].name, name, len) == 0) {
+      return &slots[slot];
     }
   }
 
   return NULL;
 }
 
-inline OPTLYDEF bool optly_flag_value_bool(const OptlyCommand *command, const char *name) {
-  const OptlyFlag *flag = optly_get_flag(command->flags, name);
-  return flag ? flag->value.as_bool : false;
-}
-
-inline OPTLYDEF char optly_flag_value_char(const OptlyCommand *command, const char *name) {
-  const OptlyFlag *flag = optly_get_flag(command->flags, name);
-  return flag ? flag->value.as_char : '\0';
-}
+/**
+ * Insert name into open-addressed table. First definition wins on duplicates, same as linear scan does.
+ */
+static void optly__index_insert(OptlyIndexSlot *slots, size_t mask, const char *name, size_t i) {
+  size_t   len  = strlen(name);
+  uint32_t hash = optly__hash(name, len);
 
-inline OPTLYDEF char *optly_flag_value_string(const OptlyCommand *command, const char *name) {
-  const OptlyFlag *flag = optly_get_flag(command->flags, name);
-  return flag ? flag->value.as_string : "";
-}
+  if (optly__index_find(slots, mask, name, len)) {
+    return;
+  }
 
-inline OPTLYDEF int8_t optly_flag_value_int8(const OptlyCommand *command, const char *name) {
-  const OptlyFlag *flag = optly_get_flag(command->flags, name);
-  return flag ? flag->value.as_int8 : 0;
-}
+  size_t slot = hash & mask;
 
-inline OPTLYDEF int16_t optly_flag_value_int16(const OptlyCommand *command, const char *name) {
-  const OptlyFlag *flag = optly_get_flag(command->flags, name);
-  return flag ? flag->value.as_int16 : 0;
-}
+  while (slots[slot].index) {
+    slot = (slot + 1) & mask;
+  }
 
-inline OPTLYDEF int32_t optly_flag_value_int32(const OptlyCommand *command, const char *name) {
-  const OptlyFlag *flag = optly_get_flag(command->flags, name);
-  return flag ? flag->value.as_int32 : 0;
+  slots[slot] = (OptlyIndexSlot){name, (uint32_t)len, hash, (uint32_t)(i + 1)};
 }
 
-inline OPTLYDEF int64_t optly_flag_value_int64(const OptlyCommand *command, const char *name) {
-  const OptlyFlag *flag = optly_get_flag(command->flags, name);
-  return flag ? flag->value.as_int64 : 0;
-}
+static bool optly__compile_enums(const OptlyCommand *cmd, OptlyIndex *index, size_t flags_count, OptlyArena *arena) {
+  index->enums = optly_arena_alloc(arena, flags_count * sizeof(*index->enums), OPTLY_ALIGNOF(OptlyIndexTable));
 
-inline OPTLYDEF uint8_t optly_flag_value_uint8(const OptlyCommand *command, const char *name) {
-  const OptlyFlag *flag = optly_get_flag(command->flags, name);
-  return flag ? flag->value.as_uint8 : 0;
-}
+  if (!index->enums) {
+    return false;
+  }
 
-inline OPTLYDEF uint16_t optly_flag_value_uint16(const OptlyCommand *command, const char *name) {
-  const OptlyFlag *flag = optly_get_flag(command->flags, name);
-  return flag ? flag->value.as_uint16 : 0;
-}
+  memset(index->enums, 0, flags_count * sizeof(*index->enums));
 
-inline OPTLYDEF uint32_t optly_flag_value_uint32(const OptlyCommand *command, const char *name) {
-  const OptlyFlag *flag = optly_get_flag(command->flags, name);
-  return flag ? flag->value.as_uint32 : 0;
-}
+  for (size_t i = 0; i < flags_count; i++) {
+    const OptlyFlag *flag  = &cmd->flags[i];
+    size_t           count = optly__enum_count(flag);
 
-inline OPTLYDEF uint64_t optly_flag_value_uint64(const OptlyCommand *command, const char *name) {
-  const OptlyFlag *flag = optly_get_flag(command->flags, name);
-  return flag ? flag->value.as_uint64 : 0;
-}
+    if (count < OPTLY_ENUM_INDEX_MIN) {
+      continue;
+    }
 
-inline OPTLYDEF float optly_flag_value_float(const OptlyCommand *command, const char *name) {
-  const OptlyFlag *flag = optly_get_flag(command->flags, name);
-  return flag ? flag->value.as_float : 0;
-}
+    OptlyIndexTable *table = &index->enums[i];
+    size_t           size  = optly__index_table_size(count);
 
-inline OPTLYDEF double optly_flag_value_double(const OptlyCommand *command, const char *name) {
-  const OptlyFlag *flag = optly_get_flag(command->flags, name);
-  return flag ? flag->value.as_double : 0;
-}
+    table->slots = optly__index_table(arena, size);
+    table->mask  = size - 1;
 
-inline OPTLYDEF char *optly_flag_value_enum(const OptlyCommand *command, const char *name) {
-  const OptlyFlag *flag = optly_get_flag(command->flags, name);
-  return flag ? flag->value.as_enum[0] : NULL;
-}
+    if (!table->slots) {
+      return false;
+    }
 
-inline OPTLYDEF OptlyPositional *optly_get_positional(OptlyCommand *command, const char *name) {
-  for (OptlyPositional *p = command->positionals; p->name; p++) {
-    if (strcmp(p->name, name) == 0) {
-      return p;
+    for (size_t v = 0; v < count; v++) {
+      optly__index_insert(table->slots, table->mask, flag->value.as_enum[v + 1], v);
     }
   }
 
-  return NULL;
+  return true;
 }
 
-#if defined(OPTLY_GEN_VERSION_FLAG) || defined(OPTLY_GEN_VERSION_COMMAND)
-OPTLYDEF OptlyErrors optly_parse_args(int argc, char *argv[], OptlyCommand *main_cmd, const char *version) {
-#else
-OPTLYDEF OptlyErrors optly_parse_args(int argc, char *argv[], OptlyCommand *main_cmd) {
-#endif
-  assert(argc > 0);
-  OptlyErrors errs = {0};
+static bool optly__compile_command(OptlyCommand *cmd, OptlyArena *arena) {
+  size_t flags_count    = cmd->flags ? optly__flags_count(cmd->flags) : 0;
+  size_t commands_count = cmd->commands ? optly__commands_count(cmd->commands) : 0;
+  size_t flags_size     = optly__index_table_size(flags_count);
+  size_t commands_size  = optly__index_table_size(commands_count);
 
-  if (main_cmd->name == NULL) {
-    main_cmd->name = argv[0];
+  if (flags_count >= UINT16_MAX || commands_count >= UINT32_MAX) {
+    OPTLY_LOG(ERROR, "Command '%s' is too big to index", cmd->name);
+    return false;
   }
 
-  OptlyCommand *current_cmd     = main_cmd;
-  bool          positional_only = false;
+  OptlyIndex *index = optly_arena_alloc(arena, sizeof(*index), OPTLY_ALIGNOF(OptlyIndex));
+
+  if (!index) {
+    OPTLY_LOG(ERROR, "Not enough memory to compile command '%s'", cmd->name);
+    return false;
+  }
 
-  SHIFT_ARG(argv, argc);
+  memset(index, 0, sizeof(*index));
 
-  while (argc > 0) {
-    char *arg = *argv;
+  index->longs    = optly__index_table(arena, flags_size);
+  index->commands = optly__index_table(arena, commands_size);
 
-    if (!arg) {
-      break;
-    }
+  if (!index->longs || !index->commands) {
+    OPTLY_LOG(ERROR, "Not enough memory to compile command '%s'", cmd->name);
+    return false;
+  }
 
-#ifdef OPTLY_GEN_HELP_FLAG
-    if (optly__is_help_flag(arg)) {
-      optly_usage(current_cmd);
-      exit(0);
-    }
-#endif
+  index->longs_mask    = flags_size - 1;
+  index->commands_mask = commands_size - 1;
 
-#ifdef OPTLY_GEN_VERSION_FLAG
-    if (optly__is_version_flag(arg)) {
-      fprintf(stderr, "%s: %s\n", main_cmd->name, version);
-      exit(0);
-    }
-#endif
+  for (size_t i = 0; i < flags_count; i++) {
+    OptlyFlag *flag = &cmd->flags[i];
 
-    if (positional_only) {
-      optly__push_positional(current_cmd, arg);
-      SHIFT_ARG(argv, argc);
-      continue;
+    if (flag->shortname && !index->shorts[(unsigned char)flag->shortname]) {
+      index->shorts[(unsigned char)flag->shortname] = (uint16_t)(i + 1);
     }
 
-    if (strcmp(arg, "--") == 0) {
-      positional_only = true;
-      SHIFT_ARG(argv, argc);
-      continue;
+    if (flag->fullname) {
+      optly__index_insert(index->longs, index->longs_mask, flag->fullname, i);
     }
+  }
 
-    if (arg[0] == '-') {
-      if (current_cmd->flags) {
-        optly__parse_flags(&argv, &argc, current_cmd->flags, &errs);
-      } else {
-        // '--flag' argument is positional if no flags defined
-        optly__push_positional(current_cmd, arg);
-      }
+  for (size_t i = 0; i < commands_count; i++) {
+    optly__index_insert(index->commands, index->commands_mask, cmd->commands[i].name, i);
+  }
 
-      SHIFT_ARG(argv, argc);
-      continue;
-    }
+  if (optly__enums_size(cmd, flags_count) && !optly__compile_enums(cmd, index, flags_count, arena)) {
+    OPTLY_LOG(ERROR, "Not enough memory to compile command '%s'", cmd->name);
+    return false;
+  }
 
-    OptlyCommand *cmd = optly__parse_command(arg, current_cmd->commands);
+  index->masks = optly_arena_alloc(arena, optly__masks_size(cmd), OPTLY_ALIGNOF(uint64_t));
 
-#ifdef OPTLY_GEN_HELP_COMMAND
-    if (strcmp(arg, "help") == 0) {
-      SHIFT_ARG(argv, argc);
+  if (!index->masks) {
+    OPTLY_LOG(ERROR, "Not enough memory to compile command '%s'", cmd->name);
+    return false;
+  }
 
-      OptlyCommand *target = current_cmd;
+  if (!optly__build_masks(cmd, index->masks)) {
+    return false;
+  }
 
-      if (argc > 0) {
-        OptlyCommand *tmp = optly__parse_command(*argv, current_cmd->commands);
-        if (!tmp) {
-          OPTLY_LOG(ERROR, "Unknown command: %s", *argv);
-          optly__push_error(&errs, OPTLY_ERR_UNKNOWN_COMMAND, *argv);
-          OPTLY_EXIT(&errs, OPTLY_ERR_UNKNOWN_COMMAND);
-        }
+  cmd->index = index;
+  return true;
+}
 
-        target = tmp;
-      }
+OPTLYDEF bool optly_compile(OptlyCommand *command, OptlyArena *arena) {
+  if (!optly__compile_command(command, arena)) {
+    return false;
+  }
 
-      optly_usage(target);
-      exit(0);
+  for (OptlyCommand *cmd = command->commands; !optly_is_command_null(cmd); cmd++) {
+    if (!cmd->provider && !optly_compile(cmd, arena)) {
+      return false;
     }
-#endif
+  }
 
-#ifdef OPTLY_GEN_VERSION_COMMAND
-    if (strcmp(arg, "version") == 0) {
-      fprintf(stderr, "%s: %s\n", main_cmd->name, version);
-      exit(0);
-    }
-#endif
+  return true;
+}
+
+static uint32_t optly__hash_string(uint32_t hash, const char *str) {
+  // NOTE: Terminator is hashed too, so "ab" "c" and "a" "bc" differ, NULL differs from ""
+  if (!str) {
+    return optly__hash_byte(hash, 0xff);
+  }
+
+  for (; *str; str++) {
+    hash = optly__hash_byte(hash, (unsigned char)*str);
+  }
+
+  return optly__hash_byte(hash, 0);
+}
+
+static uint32_t optly__hash_number(uint32_t hash, uint64_t value) {
+  for (size_t i = 0; i < 8; i++) {
+    hash = optly__hash_byte(hash, (unsigned char)(value >> (i * 8)));
+  }
+
+  return hash;
+}
+
+/**
+ * Hash of everything generated code of one command depends on: flag positions,
+ * names, types and help lines, groups, positionals and subcommands.
+ */
+OPTLYDEF uint32_t optly_schema_hash(const OptlyCommand *command) {
+  uint32_t hash = 2166136261u;
+
+  hash = optly__hash_string(hash, command->name);
+  hash = optly__hash_string(hash, command->description);
+
+  for (const OptlyFlag *flag = command->flags; flag && !optly_is_flag_null(flag); flag++) {
+    char             line[OPTLY_FLAG_BUFFER_LENGTH * 2];
+    OptlyUsageWriter w = {line, sizeof(line), 0, 0, NULL};
+
+    line[0] = '\0';
+    optly__usage_flag(&w, flag, 0);
+
+    hash = optly__hash_number(hash, (uint64_t)flag->type);
+    hash = optly__hash_number(hash, (unsigned char)flag->shortname);
+    hash = optly__hash_string(hash, flag->fullname);
+    hash = optly__hash_string(hash, line);
+  }
+
+  for (const OptlyGroup *g = command->groups; g && g->flags; g++) {
+    hash = optly__hash_number(hash, (uint64_t)g->kind);
+
+    for (const char **name = g->flags; *name; name++) {
+      hash = optly__hash_string(hash, *name);
+    }
+
+    hash = optly__hash_string(hash, g->name);
+  }
+
+  for (const OptlyPositional *pos = command->positionals; pos && pos->name; pos++) {
+    hash = optly__hash_string(hash, pos->name);
+    hash = optly__hash_number(hash, pos->min);
+    hash = optly__hash_number(hash, pos->max);
+    hash = optly__hash_number(hash, (uint64_t)pos->type);
+  }
+
+  for (const OptlyCommand *cmd = command->commands; !optly_is_command_null(cmd); cmd++) {
+    hash = optly__hash_string(hash, cmd->name);
+    hash = optly__hash_string(hash, cmd->description);
+    hash = optly__hash_number(hash, cmd->provider != NULL);
+  }
+
+  return hash;
+}
+
+static bool optly__index_matches(const OptlyCommand *cmd, const OptlyIndex *index) {
+  return index->flags_count == (cmd->flags ? optly__flags_count(cmd->flags) : 0) &&
+         index->groups_count == optly__groups_count(cmd->groups) &&
+         index->schema_hash == optly_schema_hash(cmd);
+}
+
+/**
+ * Walks command tree in the order `optly_generate` emits indexes. Provided commands are skipped.
+ * Checks every index against its command first, and installs them on second walk.
+ */
+static bool optly__install(OptlyCommand *command, OptlyIndex *const *indexes, size_t count, size_t *next, bool apply) {
+  if (*next >= count) {
+    return false;
+  }
+
+  if (apply) {
+    command->index = indexes[*next];
+  } else if (!optly__index_matches(command, indexes[*next])) {
+    OPTLY_LOG(ERROR, "Command '%s' doesn't match generated code", command->name ? command->name : "(main)");
+    return false;
+  }
+
+  (*next)++;
+
+  for (OptlyCommand *cmd = command->commands; !optly_is_command_null(cmd); cmd++) {
+    if (!cmd->provider && !optly__install(cmd, indexes, count, next, apply)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+OPTLYDEF bool optly_install(OptlyCommand *command, OptlyIndex *const *indexes, size_t count) {
+  size_t next = 0;
+
+  // NOTE: Check whole tree first, nothing is touched if it doesn't match generated code
+  if (!optly__install(command, indexes, count, &next, false) || next != count) {
+    OPTLY_LOG(ERROR, "Command tree doesn't match generated code, regenerate it");
+    return false;
+  }
+
+  next = 0;
+  return optly__install(command, indexes, count, &next, true);
+}
+
+#ifdef OPTLY_GENERATOR
+
+#ifndef OPTLY_GEN_USAGE_LENGTH
+#define OPTLY_GEN_USAGE_LENGTH (1 << 16)
+#endif
+
+#define OPTLY_GEN_IDENT_LENGTH (OPTLY_FLAG_BUFFER_LENGTH * 2)
+
+/**
+ * Position constant of a flag: PATH_NAME, short name is used for flags without long one.
+ * Everything but letters and digits becomes '_', so different names may give the same one.
+ */
+static void optly__gen_flag_ident(char *buf, const char *path, const OptlyFlag *flag) {
+  char shortname[2] = {flag->shortname, '\0'};
+
+  snprintf(buf, OPTLY_GEN_IDENT_LENGTH, "%s_%s", path, flag->fullname ? flag->fullname : shortname);
+
+  for (char *c = buf; *c; c++) {
+    if (*c >= 'a' && *c <= 'z') {
+      *c = *c - 'a' + 'A';
+    } else if (!(*c >= 'A' && *c <= 'Z') && !(*c >= '0' && *c <= '9')) {
+      *c = '_';
+    }
+  }
+}
+
+/**
+ * Find flag other than `skip` whose constant, or its _BIT or _WORD define, is spelled `ident`.
+ */
+static const OptlyFlag *optly__gen_find_ident(const OptlyCommand *cmd, const char *path, const char *ident, const OptlyFlag *skip) {
+  for (const OptlyFlag *flag = cmd->flags; flag && !optly_is_flag_null(flag); flag++) {
+    char other[OPTLY_GEN_IDENT_LENGTH];
+    optly__gen_flag_ident(other, path, flag);
+
+    size_t len = strlen(other);
+
+    bool suffix = strncmp(other, ident, len) == 0 && (strcmp(ident + len, "_BIT") == 0 || strcmp(ident + len, "_WORD") == 0);
+
+    if (flag != skip && (strcmp(other, ident) == 0 || suffix)) {
+      return flag;
+    }
+  }
+
+  for (const OptlyCommand *sub = cmd->commands; !optly_is_command_null(sub); sub++) {
+    if (sub->provider) continue;
+
+    char sub_path[OPTLY_FLAG_BUFFER_LENGTH];
+    snprintf(sub_path, sizeof(sub_path), "%s_%s", path, sub->name);
+
+    const OptlyFlag *found = optly__gen_find_ident(sub, sub_path, ident, skip);
+
+    if (found) {
+      return found;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Every flag of the tree must get its own constant, or generated code won't compile.
+ */
+static bool optly__gen_check_idents(const OptlyCommand *root, const char *prefix, const OptlyCommand *cmd, const char *path) {
+  for (const OptlyFlag *flag = cmd->flags; flag && !optly_is_flag_null(flag); flag++) {
+    char ident[OPTLY_GEN_IDENT_LENGTH];
+    optly__gen_flag_ident(ident, path, flag);
+
+    const OptlyFlag *other = optly__gen_find_ident(root, prefix, ident, flag);
+
+    if (other) {
+      OPTLY_LOG(ERROR, "Flags '%s' and '%s' of '%s' both give constant %s, rename one of them",
+                flag->fullname ? flag->fullname : "", other->fullname ? other->fullname : "", path, ident);
+      return false;
+    }
+  }
+
+  for (const OptlyCommand *sub = cmd->commands; !optly_is_command_null(sub); sub++) {
+    if (sub->provider) continue;
+
+    char sub_path[OPTLY_FLAG_BUFFER_LENGTH];
+    snprintf(sub_path, sizeof(sub_path), "%s_%s", path, sub->name);
+
+    if (!optly__gen_check_idents(root, prefix, sub, sub_path)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void optly__gen_string(FILE *out, const char *str, size_t len) {
+  fputc('"', out);
+
+  for (size_t i = 0; i < len; i++) {
+    unsigned char c = (unsigned char)str[i];
+
+    switch (c) {
+      case '"':  fputs("\\\"", out); break;
+      case '\\': fputs("\\\\", out); break;
+      case '\n': fputs("\\n", out); break;
+      case '\t': fputs("\\t", out); break;
+      case '?':  fputs("\\?", out); break;  // NOTE: No trigraphs
+      default:
+        if (c < 32 || c >= 127) {
+          fprintf(out, "\\%03o", c);
+        } else {
+          fputc(c, out);
+        }
+    }
+  }
+
+  fputc('"', out);
+}
+
+static const char *optly__gen_name(const OptlyCommand *cmd, bool commands, size_t i) {
+  return commands ? cmd->commands[i].name : cmd->flags[i].fullname;
+}
+
+/**
+ * Emit matcher of long flag or subcommand names: switch on length, then compare
+ * candidates of that length in definition order, so first definition wins.
+ */
+static void optly__gen_matcher(FILE *out, const char *prefix, const char *kind, size_t id, const OptlyCommand *cmd, bool commands) {
+  size_t count = commands ? (cmd->commands ? optly__commands_count(cmd->commands) : 0)
+                          : (cmd->flags ? optly__flags_count(cmd->flags) : 0);
+
+  fprintf(out, "static uint32_t %s_%s_%zu(const char *name, size_t len) {\n", prefix, kind, id);
+  fprintf(out, "  switch (len) {\n");
+
+  for (size_t i = 0; i < count; i++) {
+    const char *name = optly__gen_name(cmd, commands, i);
+
+    if (!name) continue;
+
+    size_t len  = strlen(name);
+    bool   seen = false;
+
+    for (size_t j = 0; j < i && !seen; j++) {
+      const char *other = optly__gen_name(cmd, commands, j);
+      seen              = other && strlen(other) == len;
+    }
+
+    if (seen) continue;
+
+    fprintf(out, "    case %zu:\n", len);
+
+    for (size_t j = i; j < count; j++) {
+      const char *other = optly__gen_name(cmd, commands, j);
+
+      if (other && strlen(other) == len) {
+        fprintf(out, "      if (memcmp(name, ");
+        optly__gen_string(out, other, len);
+        fprintf(out, ", %zu) == 0) return %zu;\n", len, j + 1);
+      }
+    }
+
+    fprintf(out, "      break;\n");
+  }
+
+  fprintf(out, "    default:\n");
+  fprintf(out, "      break;\n");
+  fprintf(out, "  }\n\n");
+  fprintf(out, "  (void)name;\n");
+  fprintf(out, "  return 0;\n");
+  fprintf(out, "}\n\n");
+}
+
+/**
+ * One word of mask `mask` laid out as in optly__build_masks.
+ */
+static uint64_t optly__gen_mask_word(const OptlyCommand *cmd, size_t mask, size_t word) {
+  uint64_t bits = 0;
+
+  if (mask == 0) {
+    for (size_t i = 0; cmd->flags && !optly_is_flag_null(&cmd->flags[i]); i++) {
+      if (cmd->flags[i].required && i / 64 == word) {
+        bits |= OPTLY_BIT(i);
+      }
+    }
+
+    return bits;
+  }
+
+  const OptlyGroup *group   = &cmd->groups[(mask - 1) / 2];
+  bool              trigger = (mask - 1) % 2 == 1;
+
+  for (const char **name = group->flags; *name; name++) {
+    size_t i     = (size_t)(optly_get_flag(cmd->flags, *name) - cmd->flags);
+    bool   first = name == group->flags && group->kind == OPTLY_GROUP_REQUIRES;
+
+    if (first == trigger && i / 64 == word) {
+      bits |= OPTLY_BIT(i);
+    }
+  }
+
+  return bits;
+}
+
+static bool optly__gen_command(FILE *out, const OptlyCommand *cmd, const char *prefix, const char *path, size_t *next) {
+  static char usage[OPTLY_GEN_USAGE_LENGTH];
+
+  size_t id          = (*next)++;
+  size_t flags_count = cmd->flags ? optly__flags_count(cmd->flags) : 0;
+
+  if (flags_count >= UINT16_MAX) {
+    OPTLY_LOG(ERROR, "Command '%s' is too big to index", cmd->name);
+    return false;
+  }
+
+  // NOTE: Constants of bool flags are for `cmd.bools` too, which has only OPTLY_BOOL_WORDS words
+  for (size_t i = 64 * OPTLY_BOOL_WORDS; i < flags_count; i++) {
+    if (cmd->flags[i].type == OPTLY_TYPE_BOOL && !cmd->flags[i].list) {
+      OPTLY_LOG(ERROR, "Bool flag '%s' of '%s' is past OptlyCommand.bools, raise OPTLY_BOOL_WORDS or move it up",
+                cmd->flags[i].fullname ? cmd->flags[i].fullname : "", cmd->name ? cmd->name : prefix);
+      return false;
+    }
+  }
+
+  for (const OptlyGroup *g = cmd->groups; g && g->flags; g++) {
+    for (const char **name = g->flags; *name; name++) {
+      if (!cmd->flags || !optly_get_flag(cmd->flags, *name)) {
+        OPTLY_LOG(FATAL, "Constraint group of '%s' refers to unknown flag '--%s'", cmd->name, *name);
+        return false;
+      }
+    }
+  }
+
+  fprintf(out, "// %s\n\n", cmd->name ? cmd->name : prefix);
+
+  if (flags_count) {
+    char ident[OPTLY_GEN_IDENT_LENGTH];
+
+    fprintf(out, "enum {\n");
+
+    for (size_t i = 0; i < flags_count; i++) {
+      optly__gen_flag_ident(ident, path, &cmd->flags[i]);
+      fprintf(out, "  %s = %zu,\n", ident, i);
+    }
+
+    fprintf(out, "};\n\n");
+
+    for (size_t i = 0; i < flags_count; i++) {
+      optly__gen_flag_ident(ident, path, &cmd->flags[i]);
+      fprintf(out, "#define %s_BIT  OPTLY_BIT(%s)\n", ident, ident);
+      fprintf(out, "#define %s_WORD OPTLY_WORD(%s)\n", ident, ident);
+    }
+
+    fprintf(out, "\n");
+  }
+
+  optly__gen_matcher(out, prefix, "long", id, cmd, false);
+  optly__gen_matcher(out, prefix, "commands", id, cmd, true);
+
+  size_t words = optly__mask_words(cmd);
+  size_t masks = words ? 1 + 2 * optly__groups_count(cmd->groups) : 0;
+
+  if (masks) {
+    fprintf(out, "static uint64_t %s_masks_%zu[] = {", prefix, id);
+
+    for (size_t m = 0; m < masks; m++) {
+      for (size_t w = 0; w < words; w++) {
+        fprintf(out, "%s0x%016llxull", m + w ? ", " : "", (unsigned long long)optly__gen_mask_word(cmd, m, w));
+      }
+    }
+
+    fprintf(out, "};\n\n");
+  }
+
+  // NOTE: Main command without name is shown as argv[0], there is nothing to precompute
+  if (cmd->name) {
+    size_t len = optly_usage_to_buffer(cmd, usage, sizeof(usage));
+
+    if (len >= sizeof(usage)) {
+      OPTLY_LOG(ERROR, "Usage of '%s' is longer than OPTLY_GEN_USAGE_LENGTH", cmd->name);
+      return false;
+    }
+
+    fprintf(out, "static const char %s_usage_%zu[] =", prefix, id);
+
+    for (size_t start = 0; start < len;) {
+      const char *eol = memchr(usage + start, '\n', len - start);
+      size_t      end = eol ? (size_t)(eol - usage) + 1 : len;
+
+      fprintf(out, "\n  ");
+      optly__gen_string(out, usage + start, end - start);
+      start = end;
+    }
+
+    fprintf(out, "%s;\n\n", len ? "" : " \"\"");
+  }
+
+  fprintf(out, "static OptlyIndex %s_index_%zu = {\n", prefix, id);
+
+  bool shorts = false;
+
+  for (size_t i = 0; i < flags_count; i++) {
+    const OptlyFlag *flag = &cmd->flags[i];
+    bool             dup  = false;
+
+    for (size_t j = 0; j < i && !dup; j++) {
+      dup = cmd->flags[j].shortname == flag->shortname;
+    }
+
+    if (!flag->shortname || dup) continue;
+
+    fprintf(out, shorts ? ", " : "  .shorts        = {");
+    fprintf(out, "[%u] = %zu", (unsigned char)flag->shortname, i + 1);  // NOTE: Numbers, so any byte is fine
+    shorts = true;
+  }
+
+  if (shorts) {
+    fprintf(out, "},\n");
+  }
+
+  if (masks) {
+    fprintf(out, "  .masks         = %s_masks_%zu,\n", prefix, id);
+  }
+
+  fprintf(out, "  .match_long    = %s_long_%zu,\n", prefix, id);
+  fprintf(out, "  .match_command = %s_commands_%zu,\n", prefix, id);
+
+  if (cmd->name) {
+    fprintf(out, "  .usage         = %s_usage_%zu,\n", prefix, id);
+  }
+
+  fprintf(out, "  .flags_count   = %zu,\n", flags_count);
+  fprintf(out, "  .groups_count  = %zu,\n", optly__groups_count(cmd->groups));
+  fprintf(out, "  .schema_hash   = 0x%08xu,\n", (unsigned)optly_schema_hash(cmd));
+  fprintf(out, "};\n\n");
+
+  for (const OptlyCommand *sub = cmd->commands; !optly_is_command_null(sub); sub++) {
+    if (sub->provider) continue;
+
+    char sub_path[OPTLY_FLAG_BUFFER_LENGTH];
+    snprintf(sub_path, sizeof(sub_path), "%s_%s", path, sub->name);
+
+    if (!optly__gen_command(out, sub, prefix, sub_path, next)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+OPTLYDEF bool optly_generate(const OptlyCommand *command, const char *prefix, FILE *out) {
+  size_t count = 0;
+
+  if (!optly__gen_check_idents(command, prefix, command, prefix)) {
+    return false;
+  }
+
+  fprintf(out, "// Generated by optly_generate, do not edit.\n");
+  fprintf(out, "// Include after optly.h and call %s_install on the schema it was generated from.\n\n", prefix);
+  fprintf(out, "#include <string.h>\n\n");
+
+  if (!optly__gen_command(out, command, prefix, prefix, &count)) {
+    return false;
+  }
+
+  fprintf(out, "static OptlyIndex *const %s_indexes[] = {", prefix);
+
+  for (size_t i = 0; i < count; i++) {
+    fprintf(out, "%s&%s_index_%zu", i ? ", " : "", prefix, i);
+  }
+
+  fprintf(out, "};\n\n");
+  fprintf(out, "static inline bool %s_install(OptlyCommand *command) {\n", prefix);
+  fprintf(out, "  return optly_install(command, %s_indexes, %zu);\n", prefix, count);
+  fprintf(out, "}\n");
+
+  return !ferror(out);
+}
+
+#endif  // OPTLY_GENERATOR
+
+static const OptlyFlag *optly__index_short(const OptlyCommand *cmd, char shortname) {
+  uint16_t i = cmd->index->shorts[(unsigned char)shortname];
+  return i ? &cmd->flags[i - 1] : NULL;
+}
+
+static const OptlyFlag *optly__index_long(const OptlyCommand *cmd, const char *name, size_t len) {
+  const OptlyIndex *index = cmd->index;
+
+  if (index->match_long) {
+    uint32_t i = index->match_long(name, len);
+    return i ? &cmd->flags[i - 1] : NULL;
+  }
+
+  const OptlyIndexSlot *slot = optly__index_find(index->longs, index->longs_mask, name, len);
+
+  return slot ? &cmd->flags[slot->index - 1] : NULL;
+}
+
+/**
+ * Check if first `len` bytes of argument (`--name` or `-n`) match a flag definition.
+ */
+static bool optly__flag_matches(const char *arg, size_t len, const OptlyFlag *flag) {
+  bool is_short = arg[1] != '-';
+
+  return (!is_short && flag->fullname && strncmp(flag->fullname, arg + 2, len - 2) == 0 && flag->fullname[len - 2] == '\0') ||
+         (is_short && len == 2 && (arg[1] == flag->shortname));
+}
+
+/**
+ * Find a flag by first `len` bytes of argument. Uses command index if it was compiled.
+ */
+static const OptlyFlag *optly__find_flag(const char *arg, size_t len, const OptlyCommand *cmd) {
+  if (cmd->index) {
+    return arg[1] != '-' ? (len == 2 ? optly__index_short(cmd, arg[1]) : NULL) : optly__index_long(cmd, arg + 2, len - 2);
+  }
+
+  for (const OptlyFlag *f = cmd->flags; !optly_is_flag_null(f); f++) {
+    if (optly__flag_matches(arg, len, f)) {
+      return f;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Find a flag by its long name.
+ */
+static const OptlyFlag *optly__lookup_flag(const OptlyCommand *cmd, const char *name) {
+  if (cmd->index) {
+    return optly__index_long(cmd, name, strlen(name));
+  }
+
+  return cmd->flags ? optly_get_flag(cmd->flags, name) : NULL;
+}
+
+static unsigned optly__digit(char c) {
+  if (c >= '0' && c <= '9') return (unsigned)(c - '0');
+  if (c >= 'a' && c <= 'f') return (unsigned)(c - 'a' + 10);
+  if (c >= 'A' && c <= 'F') return (unsigned)(c - 'A' + 10);
+  return 16;
+}
+
+/**
+ * Parse unsigned number not bigger than `max`: decimal, 0x hex, 0o or 0 octal,
+ * 0b binary. `_` may separate digits. Doesn't look at locale.
+ */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define OPTLY__SWAR
+#endif
+
+#ifdef OPTLY__SWAR
+/**
+ * Value of 8 ASCII digits or UINT64_MAX if any of them is not a digit. All 8
+ * are checked and combined with a few multiplies instead of 8 loop steps.
+ */
+static uint64_t optly__swar8(const char *s) {
+  uint64_t v;
+  memcpy(&v, s, sizeof(v));
+
+  // NOTE: Byte is digit if its high nibble is 3 and adding 6 doesn't move it
+  if (((v & 0xF0F0F0F0F0F0F0F0) | (((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) != 0x3333333333333333) {
+    return UINT64_MAX;
+  }
+
+  v -= 0x3030303030303030;
+  v = (v * 10 + (v >> 8)) & 0x00FF00FF00FF00FF;
+  v = (v * 100 + (v >> 16)) & 0x0000FFFF0000FFFF;
+  v = (v * 10000 + (v >> 32)) & 0x00000000FFFFFFFF;
+  return v;
+}
+
+/**
+ * Plain decimal of 8..19 digits, which can't overflow uint64. False if it's
+ * something else, general parser deals with it then.
+ */
+static bool optly__parse_decimal_swar(const char *s, uint64_t max, uint64_t *out) {
+  size_t len = strlen(s);
+
+  if (len < 8 || len > 19) {
+    return false;
+  }
+
+  uint64_t value = 0;
+  uint64_t chunk = 0;
+  size_t   i     = 0;
+
+  for (; i + 8 <= len && (chunk = optly__swar8(s + i)) != UINT64_MAX; i += 8) {
+    value = value * 100000000 + chunk;
+  }
+
+  for (; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
+    value = value * 10 + (uint64_t)(s[i] - '0');
+  }
+
+  if (i != len || value > max) {
+    return false;
+  }
+
+  *out = value;
+  return true;
+}
+#endif
+
+static bool optly__parse_uint(const char *str, uint64_t max, uint64_t *out) {
+  const char *s      = str;
+  unsigned    base   = 10;
+  bool        digits = false;  // Last character was a digit
+
+  if (*s == '+') s++;
+
+  if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+    base = 16, s += 2;
+  } else if (s[0] == '0' && (s[1] == 'b' || s[1] == 'B')) {
+    base = 2, s += 2;
+  } else if (s[0] == '0' && (s[1] == 'o' || s[1] == 'O')) {
+    base = 8, s += 2;
+  } else if (s[0] == '0' && s[1] != '\0') {
+    base = 8, s += 1, digits = true;
+  }
+
+#ifdef OPTLY__SWAR
+  if (base == 10 && optly__parse_decimal_swar(s, max, out)) {
+    return true;
+  }
+#endif
+
+  uint64_t value = 0;
+
+  for (; *s; s++) {
+    if (*s == '_' && digits) {
+      digits = false;
+      continue;
+    }
+
+    unsigned d = optly__digit(*s);
+
+    if (d >= base || value > (max - d) / base) {
+      return false;
+    }
+
+    value  = value * base + d;
+    digits = true;
+  }
+
+  *out = value;
+  return digits;
+}
+
+static bool optly__parse_int(const char *str, int64_t max, int64_t *out) {
+  bool     negative = *str == '-';
+  uint64_t value    = 0;
+
+  // NOTE: Negative side has one more value than positive (-128..127)
+  if (!optly__parse_uint(str + negative, (uint64_t)max + negative, &value) || (negative && str[1] == '+')) {
+    return false;
+  }
+
+  *out = negative && value > 0 ? -(int64_t)(value - 1) - 1 : (int64_t)value;
+  return true;
+}
+
+/**
+ * Clinger's fast path: decimal with at most 19 significant digits whose mantissa
+ * and power of ten are both exact in double is correctly rounded by a single
+ * multiplication or division. Returns false if number doesn't fit, caller falls
+ * back to strtod then.
+ */
+static bool optly__parse_double_fast(const char *s, double *out, bool single) {
+#if FLT_EVAL_METHOD == 0
+  static const double pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+  bool     negative = *s == '-';
+  uint64_t mantissa = 0;
+  int      digits   = 0;
+  int      exponent = 0;
+  bool     any      = false;
+
+  if (*s == '-' || *s == '+') s++;
+
+  for (bool fraction = false;; s++) {
+    if (*s == '.' && !fraction) {
+      fraction = true;
+      continue;
+    }
+
+    if (*s == '_' && any && s[-1] >= '0' && s[-1] <= '9' && s[1] >= '0' && s[1] <= '9') {
+      continue;
+    }
+
+    if (*s < '0' || *s > '9') {
+      break;
+    }
+
+    if (mantissa == 0 && *s == '0') {
+      exponent -= fraction;
+    } else if (++digits > 19) {
+      return false;
+    } else {
+      mantissa  = mantissa * 10 + (uint64_t)(*s - '0');
+      exponent -= fraction;
+    }
+
+    any = true;
+  }
+
+  if (!any) {
+    return false;
+  }
+
+  if (*s == 'e' || *s == 'E') {
+    s++;
+
+    bool negative_exp = *s == '-';
+    int  exp          = 0;
+
+    if (*s == '-' || *s == '+') s++;
+    if (*s < '0' || *s > '9') return false;
+
+    for (; *s >= '0' && *s <= '9'; s++) {
+      if (exp < 1000) exp = exp * 10 + (*s - '0');
+    }
+
+    exponent += negative_exp ? -exp : exp;
+  }
+
+  // Float gets its own limits, rounding through double could be off by one ulp
+  uint64_t max_mantissa = single ? (uint64_t)1 << 24 : (uint64_t)1 << 53;
+  int      max_exponent = single ? 10 : 22;
+
+  if (*s != '\0' || mantissa > max_mantissa || exponent > max_exponent || exponent < -max_exponent) {
+    return false;
+  }
+
+  if (single) {
+    float value = (float)mantissa;
+    float scale = (float)pow10[exponent < 0 ? -exponent : exponent];
+
+    value = exponent < 0 ? value / scale : value * scale;
+    *out  = negative ? -value : value;
+  } else {
+    double value = (double)mantissa;
+
+    value = exponent < 0 ? value / pow10[-exponent] : value * pow10[exponent];
+    *out  = negative ? -value : value;
+  }
+
+  return true;
+#else
+  (void)s, (void)out, (void)single;
+  return false;
+#endif
+}
+
+/**
+ * Everything fast path can't handle goes to strtod. Point and separators are
+ * replaced first, and locale's own decimal point is refused, so whatever locale
+ * says about decimal point doesn't matter.
+ */
+static bool optly__parse_double(const char *str, double *out, bool single) {
+  if (optly__parse_double_fast(str, out, single)) {
+    return true;
+  }
+
+  char        buf[OPTLY_FLAG_BUFFER_LENGTH];
+  const char *point     = localeconv()->decimal_point;
+  size_t      point_len = strcmp(point, ".") == 0 ? 0 : strlen(point);
+  size_t      len       = 0;
+
+  for (const char *s = str; *s; s++) {
+    if (*s == '_' && s != str && s[-1] >= '0' && s[-1] <= '9' && s[1] >= '0' && s[1] <= '9') {
+      continue;
+    }
+
+    // NOTE: Like in C locale, '1,5' is not a number even where strtod would take it
+    if (point_len && strncmp(s, point, point_len) == 0) {
+      return false;
+    }
+
+    const char *part = *s == '.' ? point : s;
+    size_t      size = *s == '.' ? strlen(point) : 1;
+
+    if (len + size >= sizeof(buf)) {
+      return false;
+    }
+
+    memcpy(buf + len, part, size);
+    len += size;
+  }
+
+  buf[len] = '\0';
+
+  char *end = NULL;
+  errno     = 0;
+
+  if (single) {
+    float value = strtof(buf, &end);
+
+    if (errno == ERANGE && (value == HUGE_VALF || value == -HUGE_VALF)) return false;
+    *out = value;
+  } else {
+    double value = strtod(buf, &end);
+
+    if (errno == ERANGE && (value == HUGE_VAL || value == -HUGE_VAL)) return false;
+    *out = value;
+  }
+
+  return len > 0 && *end == '\0';
+}
+
+/**
+ * Read `digits[.digits]` (with `_` between digits) for unit parsers. Fraction
+ * is kept as `frac / scale`, digits past 18th are dropped.
+ */
+static bool optly__parse_decimal(const char **str, uint64_t *whole, uint64_t *frac, uint64_t *scale) {
+  const char *s   = *str;
+  bool        any = false;
+
+  *whole = 0, *frac = 0, *scale = 1;
+
+  for (; (*s >= '0' && *s <= '9') || (*s == '_' && any && s[1] >= '0' && s[1] <= '9'); s++) {
+    if (*s == '_') continue;
+    if (*whole > (UINT64_MAX - 9) / 10) return false;
+
+    *whole = *whole * 10 + (uint64_t)(*s - '0');
+    any    = true;
+  }
+
+  if (*s == '.' && s[1] >= '0' && s[1] <= '9') {
+    for (s++; *s >= '0' && *s <= '9'; s++) {
+      if (*scale < 1000000000000000000ull) {
+        *frac  = *frac * 10 + (uint64_t)(*s - '0');
+        *scale *= 10;
+      }
+    }
+
+    any = true;
+  }
+
+  *str = s;
+  return any;
+}
+
+/**
+ * `whole.frac` times `unit`, false on overflow.
+ */
+static bool optly__scale(uint64_t whole, uint64_t frac, uint64_t scale, uint64_t unit, uint64_t *out) {
+  if (unit != 0 && whole > UINT64_MAX / unit) {
+    return false;
+  }
+
+  uint64_t part = (uint64_t)((double)frac / (double)scale * (double)unit);
+
+  if (whole * unit > UINT64_MAX - part) {
+    return false;
+  }
+
+  *out = whole * unit + part;
+  return true;
+}
+
+/**
+ * 4096, 4k, 4K, 4KiB are binary, 4KB is decimal. Returns reason if value is invalid.
+ */
+static const char *optly__parse_size(const char *s, uint64_t *out) {
+  static const char units[] = "KMGTPE";
+
+  uint64_t whole, frac, scale;
+
+  if (!optly__parse_decimal(&s, &whole, &frac, &scale)) return "expected number";
+
+  uint64_t unit = 1;
+
+  if (*s != '\0' && strcmp(s, "B") != 0) {
+    char        letter = (char)(*s >= 'a' && *s <= 'z' ? *s - 'a' + 'A' : *s);
+    const char *found  = letter ? strchr(units, letter) : NULL;
+
+    if (!found) return "unknown size unit";
+
+    bool decimal = strcmp(s + 1, "B") == 0;
+
+    if (!decimal && s[1] != '\0' && strcmp(s + 1, "iB") != 0) return "unknown size unit";
+
+    for (const char *u = units; u <= found; u++) {
+      unit *= decimal ? 1000 : 1024;
+    }
+  }
+
+  if (unit == 1 && frac != 0) return "fraction of a byte";
+  if (!optly__scale(whole, frac, scale, unit, out)) return "size is too big";
+
+  return NULL;
+}
+
+static uint64_t optly__duration_unit(const char *s, size_t len) {
+  static const struct {
+    const char *name;
+    uint64_t    ns;
+  } units[] = {
+    {"ns", 1},
+    {"us", 1000},
+    {"\xC2\xB5s", 1000},  // µs
+    {"ms", 1000000},
+    {"s", 1000000000},
+    {"m", 60000000000},
+    {"min", 60000000000},
+    {"h", 3600000000000},
+    {"d", 86400000000000},
+  };
+
+  for (size_t i = 0; i < sizeof(units) / sizeof(*units); i++) {
+    if (strlen(units[i].name) == len && strncmp(units[i].name, s, len) == 0) {
+      return units[i].ns;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Sequence of number+unit pairs: 250ms, 1h30m, -1.5s. Plain 0 needs no unit.
+ */
+static const char *optly__parse_duration(const char *s, int64_t *out) {
+  bool     negative = *s == '-';
+  uint64_t total    = 0;
+
+  if (*s == '-' || *s == '+') s++;
+
+  if (strcmp(s, "0") == 0) {
+    *out = 0;
+    return NULL;
+  }
+
+  if (*s == '\0') return "expected number";
+
+  while (*s) {
+    uint64_t whole, frac, scale, part;
+
+    if (!optly__parse_decimal(&s, &whole, &frac, &scale)) return "expected number";
+
+    const char *unit = s;
+    while (*s && !(*s >= '0' && *s <= '9') && *s != '.') s++;
+
+    if (unit == s) return "missing duration unit";
+
+    uint64_t ns = optly__duration_unit(unit, (size_t)(s - unit));
+
+    if (!ns) return "unknown duration unit";
+    if (!optly__scale(whole, frac, scale, ns, &part) || part > (uint64_t)INT64_MAX - total) return "duration is too long";
+
+    total += part;
+  }
+
+  *out = negative ? -(int64_t)total : (int64_t)total;
+  return NULL;
+}
+
+/**
+ * Number with optional k/M/G multiplier and optional per-unit: 100, 10k/s, 5/ms, 1.5M/min.
+ * Result is per second.
+ */
+static const char *optly__parse_rate(const char *s, double *out) {
+  uint64_t whole, frac, scale;
+
+  if (!optly__parse_decimal(&s, &whole, &frac, &scale)) return "expected number";
+
+  double value = (double)whole + (double)frac / (double)scale;
+
+  switch (*s) {
+    case 'k':
+    case 'K': value *= 1e3, s++; break;
+    case 'M': value *= 1e6, s++; break;
+    case 'G': value *= 1e9, s++; break;
+    default:  break;
+  }
+
+  if (*s == '/') {
+    uint64_t ns = optly__duration_unit(s + 1, strlen(s + 1));
+
+    if (!ns) return "unknown rate unit";
+
+    value = value * 1e9 / (double)ns;
+  } else if (*s != '\0') {
+    return "unknown rate multiplier";
+  }
+
+  *out = value;
+  return NULL;
+}
+
+/**
+ * Comma separated CPU numbers and ranges: 0-7,16-23.
+ */
+static const char *optly__parse_cpuset(const char *s, OptlyCpuSet *set) {
+  memset(set, 0, sizeof(*set));
+
+  do {
+    uint64_t first, last;
+
+    if (*s == ',') s++;
+    if (*s < '0' || *s > '9') return "expected CPU number";
+
+    for (first = 0; *s >= '0' && *s <= '9' && first < OPTLY_MAX_CPUS; s++) first = first * 10 + (uint64_t)(*s - '0');
+
+    last = first;
+
+    if (*s == '-') {
+      if (*++s < '0' || *s > '9') return "expected CPU number";
+      for (last = 0; *s >= '0' && *s <= '9' && last < OPTLY_MAX_CPUS; s++) last = last * 10 + (uint64_t)(*s - '0');
+    }
+
+    if (first >= OPTLY_MAX_CPUS || last >= OPTLY_MAX_CPUS) return "CPU number is too big";
+    if (first > last) return "CPU range is reversed";
+    if (*s != ',' && *s != '\0') return "unexpected character in CPU list";
+
+    for (uint64_t cpu = first; cpu <= last; cpu++) {
+      set->bits[cpu / 64] |= (uint64_t)1 << (cpu % 64);
+    }
+  } while (*s);
+
+  return NULL;
+}
+
+/**
+ * Find enum value among candidates, through hashed table if `optly_compile` made one.
+ */
+static char **optly__enum_find(const OptlyCommand *cmd, const OptlyFlag *flag, const char *value) {
+  char **candidates = flag->value.as_enum + 1;
+
+  if (cmd->index && cmd->index->enums && cmd->index->enums[flag - cmd->flags].slots) {
+    const OptlyIndexTable *table = &cmd->index->enums[flag - cmd->flags];
+    const OptlyIndexSlot  *slot  = optly__index_find(table->slots, table->mask, value, strlen(value));
+
+    return slot ? &candidates[slot->index - 1] : NULL;
+  }
+
+  for (char **v = candidates; *v; v++) {
+    if (strcmp(*v, value) == 0) {
+      return v;
+    }
+  }
+
+  return NULL;
+}
+
+static bool optly__flag_set_value(const OptlyCommand *cmd, const OptlyFlag *flag, OptlyFlagValue *dst, char *value, OptlyArena *arena, OptlyErrors *errs) {
+  assert(flag);
+
+  if (flag->type != OPTLY_TYPE_BOOL && !value) {
+    OPTLY_LOG(FATAL, "Flag --%s requires value", flag->fullname);
+    optly__push_error(errs, OPTLY_ERR_MISSING_VALUE, flag->fullname);
+    return false;
+  }
+
+  // NOTE: Parsed into zeroed value, so narrow types don't leave garbage in the union,
+  //       and flag keeps its previous value if parsing fails
+  OptlyFlagValue parsed = {.as_int64 = 0};
+
+  bool        ok     = true;
+  int64_t     i      = 0;
+  uint64_t    u      = 0;
+  double      d      = 0;
+  const char *reason = NULL;
+
+  switch (flag->type) {
+    case OPTLY_TYPE_CHAR:     parsed.as_char = *value; break;
+    case OPTLY_TYPE_STRING:   parsed.as_string = value; break;
+    case OPTLY_TYPE_INT8:     ok = optly__parse_int(value, INT8_MAX, &i), parsed.as_int8 = (int8_t)i; break;
+    case OPTLY_TYPE_INT16:    ok = optly__parse_int(value, INT16_MAX, &i), parsed.as_int16 = (int16_t)i; break;
+    case OPTLY_TYPE_INT32:    ok = optly__parse_int(value, INT32_MAX, &i), parsed.as_int32 = (int32_t)i; break;
+    case OPTLY_TYPE_INT64:    ok = optly__parse_int(value, INT64_MAX, &i), parsed.as_int64 = i; break;
+    case OPTLY_TYPE_UINT8:    ok = optly__parse_uint(value, UINT8_MAX, &u), parsed.as_uint8 = (uint8_t)u; break;
+    case OPTLY_TYPE_UINT16:   ok = optly__parse_uint(value, UINT16_MAX, &u), parsed.as_uint16 = (uint16_t)u; break;
+    case OPTLY_TYPE_UINT32:   ok = optly__parse_uint(value, UINT32_MAX, &u), parsed.as_uint32 = (uint32_t)u; break;
+    case OPTLY_TYPE_UINT64:   ok = optly__parse_uint(value, UINT64_MAX, &u), parsed.as_uint64 = u; break;
+    case OPTLY_TYPE_FLOAT:    ok = optly__parse_double(value, &d, true), parsed.as_float = (float)d; break;
+    case OPTLY_TYPE_DOUBLE:   ok = optly__parse_double(value, &d, false), parsed.as_double = d; break;
+    case OPTLY_TYPE_BOOL:     parsed.as_bool = true; break;
+    case OPTLY_TYPE_ENUM:     {
+      char **match = optly__enum_find(cmd, flag, value);
+
+      if (!match) {
+        OPTLY_LOG(ERROR, "Invalid enum value '%s' for --%s", value, flag->fullname);
+        optly__push_error(errs, OPTLY_ERR_INVALID_VALUE, value);
+        return false;
+      }
+
+      // NOTE: Selected value points into candidates list, so `as_enum[0]` is always current value
+      parsed.as_enum = match;
+      break;
+    }
+    case OPTLY_TYPE_SIZE:     reason = optly__parse_size(value, &parsed.as_uint64); break;
+    case OPTLY_TYPE_DURATION: reason = optly__parse_duration(value, &parsed.as_int64); break;
+    case OPTLY_TYPE_RATE:     reason = optly__parse_rate(value, &parsed.as_double); break;
+    case OPTLY_TYPE_CPUSET:   {
+      parsed.as_cpuset = optly_arena_alloc(arena, sizeof(OptlyCpuSet), OPTLY_ALIGNOF(OptlyCpuSet));
+
+      if (!parsed.as_cpuset) {
+        OPTLY_LOG(ERROR, "Not enough memory for CPU set of --%s", flag->fullname);
+        optly__push_error(errs, OPTLY_ERR_OUT_OF_MEMORY, flag->fullname);
+        return false;
+      }
+
+      reason = optly__parse_cpuset(value, parsed.as_cpuset);
+      break;
+    }
+    case OPTLY_TYPE_CUSTOM:   {
+      const OptlyConverter *conv = flag->converter;
+
+      if (!conv || !conv->convert) {
+        OPTLY_LOG(FATAL, "Flag --%s has custom type without converter", flag->fullname);
+        optly__push_error(errs, OPTLY_ERR_INVALID_VALUE, value);
+        return false;
+      }
+
+      parsed.as_custom = optly_arena_alloc(arena, conv->size ? conv->size : 1, conv->align ? conv->align : sizeof(void *));
+
+      if (!parsed.as_custom) {
+        OPTLY_LOG(ERROR, "Not enough memory for value of --%s", flag->fullname);
+        optly__push_error(errs, OPTLY_ERR_OUT_OF_MEMORY, flag->fullname);
+        return false;
+      }
+
+      reason = conv->convert(flag, value, parsed.as_custom);
+      break;
+    }
+  }
+
+  if (reason) {
+    OPTLY_LOG(ERROR, "Invalid value for --%s '%s': %s", flag->fullname, value, reason);
+    optly__push_error(errs, OPTLY_ERR_INVALID_VALUE, value);
+    return false;
+  }
+
+  if (!ok) {
+    OPTLY_LOG(ERROR, "Argument '%s' is not a valid number (%s)", flag->fullname, value);
+    optly__push_error(errs, OPTLY_ERR_INVALID_VALUE, value);
+    return false;
+  }
+
+  *dst = parsed;
+  return true;
+}
+
+typedef enum OptlyTokenKind {
+  OPTLY__TOKEN_VALUE,      // Doesn't start with '-': command, positional or flag value
+  OPTLY__TOKEN_DELIMITER,  // --
+  OPTLY__TOKEN_LONG,       // --name, --name=value
+  OPTLY__TOKEN_SHORT,      // -n, -n=value (and lone '-')
+  OPTLY__TOKEN_BATCH,      // -abc
+} OptlyTokenKind;
+
+// Everything parser needs to know about token, found in one scan
+typedef struct OptlyToken {
+  char          *arg;
+  size_t         len;
+  size_t         eq;  // Offset of first '=', `len` if there is none
+  OptlyTokenKind kind;
+} OptlyToken;
+
+/**
+ * Length and '=' come from strlen and memchr, which libc does with SIMD, every
+ * later stage reads them from here instead of scanning token again.
+ */
+static OptlyToken optly__classify(char *arg) {
+  OptlyToken  token = {.arg = arg, .len = strlen(arg)};
+  const char *eq    = arg[0] == '-' ? memchr(arg, '=', token.len) : NULL;
+
+  token.eq = eq ? (size_t)(eq - arg) : token.len;
+
+  if (arg[0] != '-') {
+    token.kind = OPTLY__TOKEN_VALUE;
+  } else if (arg[1] == '-') {
+    token.kind = token.len == 2 ? OPTLY__TOKEN_DELIMITER : OPTLY__TOKEN_LONG;
+  } else if (token.len > 2 && arg[2] != '=') {
+    token.kind = OPTLY__TOKEN_BATCH;
+  } else {
+    token.kind = OPTLY__TOKEN_SHORT;
+  }
+
+  return token;
+}
+
+/**
+ * Long form or short letter among batched (or single) short flags.
+ */
+inline static bool optly__token_is(const OptlyToken *token, const char *full, size_t full_len, char letter) {
+  if (token->kind == OPTLY__TOKEN_LONG) {
+    return token->len == full_len && memcmp(token->arg, full, full_len) == 0;
+  }
+
+  if (token->kind == OPTLY__TOKEN_SHORT) {
+    return token->len == 2 && token->arg[1] == letter;
+  }
+
+  return token->kind == OPTLY__TOKEN_BATCH && memchr(token->arg + 1, letter, token->eq - 1) != NULL;
+}
+
+inline static bool optly__is_help_flag(const OptlyToken *token) {
+  return optly__token_is(token, "--help", 6, OPTLY_HELP_SHORT_FLAG[1]);
+}
+
+inline static bool optly__is_version_flag(const OptlyToken *token) {
+  return optly__token_is(token, "--version", 9, OPTLY_VERSION_SHORT_FLAG[1]);
+}
+
+/**
+ * Grow allocation in place if it is the last one in arena, move it otherwise.
+ */
+static void *optly__arena_grow(OptlyArena *arena, void *ptr, size_t old_size, size_t new_size, size_t align) {
+  unsigned char *bytes = ptr;
+
+  if (bytes && bytes + old_size == arena->base + arena->used && new_size - old_size <= arena->size - arena->used) {
+    arena->used += new_size - old_size;
+    return ptr;
+  }
+
+  void *moved = optly_arena_alloc(arena, new_size, align);
+
+  if (moved && bytes) {
+    memcpy(moved, bytes, old_size);
+  }
+
+  return moved;
+}
+
+static void optly__out_of_memory(OptlyParser *p, const char *arg) {
+  OPTLY_LOG(ERROR, "Not enough memory to parse '%s'", arg);
+  optly__push_error(&p->result->errors, OPTLY_ERR_OUT_OF_MEMORY, arg);
+  p->out_of_memory = true;
+}
+
+static size_t optly__positionals_count(const OptlyPositional *positionals) {
+  size_t count = 0;
+
+  for (const OptlyPositional *pos = positionals; pos && pos->name; pos++) {
+    count++;
+  }
+
+  return count;
+}
+
+static size_t optly__value_size(OptlyFlagType type) {
+  switch (type) {
+    case OPTLY_TYPE_BOOL:     return sizeof(bool);
+    case OPTLY_TYPE_CHAR:     return sizeof(char);
+    case OPTLY_TYPE_INT8:     return sizeof(int8_t);
+    case OPTLY_TYPE_INT16:    return sizeof(int16_t);
+    case OPTLY_TYPE_INT32:    return sizeof(int32_t);
+    case OPTLY_TYPE_INT64:    return sizeof(int64_t);
+    case OPTLY_TYPE_UINT8:    return sizeof(uint8_t);
+    case OPTLY_TYPE_UINT16:   return sizeof(uint16_t);
+    case OPTLY_TYPE_UINT32:   return sizeof(uint32_t);
+    case OPTLY_TYPE_UINT64:   return sizeof(uint64_t);
+    case OPTLY_TYPE_FLOAT:    return sizeof(float);
+    case OPTLY_TYPE_DOUBLE:   return sizeof(double);
+    case OPTLY_TYPE_SIZE:     return sizeof(uint64_t);
+    case OPTLY_TYPE_DURATION: return sizeof(int64_t);
+    case OPTLY_TYPE_RATE:     return sizeof(double);
+    default:                  return sizeof(void *);
+  }
+}
+
+/**
+ * Convert all values of typed positional in one go into contiguous array. Under
+ * `optly_parse_args` it is schema list, values that don't fit are only checked.
+ */
+static void optly__convert_positional(OptlyParser *p, const OptlyPositional *def, OptlyValues *pos) {
+  if (def->type == OPTLY_TYPE_ENUM || def->type == OPTLY_TYPE_CUSTOM) {
+    OPTLY_LOG(ERROR, "Positional '%s' can't be of enum or custom type", def->name);
+    optly__push_error(&p->result->errors, OPTLY_ERR_INVALID_VALUE, def->name);
+    return;
+  }
+
+  OptlyArena     *arena    = &p->result->arena;
+  size_t          size     = optly__value_size(def->type);
+  size_t          capacity = pos->count;
+  unsigned char  *typed    = NULL;
+  const OptlyFlag flag     = {.fullname = def->name, .type = def->type};
+
+  if (p->in_schema) {
+    capacity = def->list ? def->list->capacity : 0;
+    typed    = def->list ? def->list->items : NULL;
+
+    if (def->list && pos->count > capacity) {
+      OPTLY_LOG(ERROR, "List of %s can't hold %zu values", def->name, pos->count);
+      optly__push_error(&p->result->errors, OPTLY_ERR_OUT_OF_MEMORY, def->name);
+    }
+  } else {
+    typed = optly_arena_alloc(arena, pos->count * size, size);
+
+    if (!typed) {
+      optly__out_of_memory(p, def->name);
+      return;
+    }
+  }
+
+  for (size_t i = 0; i < pos->count; i++) {
+    OptlyFlagValue parsed;
+
+    if (optly__flag_set_value(p->level->command, &flag, &parsed, pos->items[i], arena, &p->result->errors) && i < capacity) {
+      memcpy(typed + i * size, &parsed, size);
+    }
+  }
+
+  if (p->in_schema && def->list) {
+    def->list->count = pos->count < capacity ? pos->count : capacity;
+  }
+
+  pos->typed = typed;
+}
+
+/**
+ * Distribute collected values between positionals and point each one at its
+ * slice. Values are kept in order they came, so it is just a matter of counts:
+ * every positional gets its minimum (at least 1) in order, the rest is given
+ * back to front up to each positional's max. Whatever is left goes to the last
+ * one, so validation reports it.
+ */
+static void optly__finish_positionals(OptlyParser *p) {
+  OptlyResultCommand    *level = p->level;
+  const OptlyPositional *defs  = level->command->positionals;
+  OptlyValues           *pos   = level->positionals;
+  size_t                 count = optly__positionals_count(defs);
+  size_t                 left  = p->run_count;
+
+  // NOTE: Streamed positional is counted already and never gets stored values
+  if (p->stream) {
+    count--;
+  }
+
+  if (count == 0) {
+    return;
+  }
+
+  for (size_t i = 0; i < count && left > 0; i++) {
+    size_t min = defs[i].min == 0 ? 1 : defs[i].min;
+
+    pos[i].count = min < left ? min : left;
+    left -= pos[i].count;
+  }
+
+  for (size_t i = count; i > 0 && left > 0; i--) {
+    size_t room = defs[i - 1].max == 0 ? left : defs[i - 1].max > pos[i - 1].count ? defs[i - 1].max - pos[i - 1].count : 0;
+    size_t take = room < left ? room : left;
+
+    pos[i - 1].count += take;
+    left -= take;
+  }
+
+  pos[count - 1].count += left;
+
+  char **items = p->run;
+
+  for (size_t i = 0; i < count; i++) {
+    pos[i].items = items;
+    items += pos[i].count;
+
+    if (defs[i].type != OPTLY_TYPE_BOOL && defs[i].type != OPTLY_TYPE_STRING) {
+      optly__convert_positional(p, &defs[i], &pos[i]);
+    }
+  }
+}
+
+static size_t optly__align_up(size_t size, size_t align) {
+  return (size + align - 1) & ~(align - 1);
+}
+
+/**
+ * State of one command is a single block: header, then bools and present bits,
+ * which share first cache line with it for commands up to 64 flags, then values
+ * and positionals. Fills offsets of those four parts and returns block size.
+ */
+static size_t optly__level_layout(const OptlyCommand *cmd, size_t offsets[4]) {
+  size_t flags_count       = cmd->flags ? optly__flags_count(cmd->flags) : 0;
+  size_t positionals_count = optly__positionals_count(cmd->positionals);
+  size_t words             = (flags_count + 63) / 64;
+  size_t size              = optly__align_up(sizeof(OptlyResultCommand), OPTLY_ALIGNOF(uint64_t));
+
+  offsets[0] = size;
+  offsets[1] = size += words * sizeof(uint64_t);
+  offsets[2] = size = optly__align_up(size + words * sizeof(uint64_t), OPTLY_ALIGNOF(OptlyFlagValue));
+  offsets[3] = size = optly__align_up(size + flags_count * sizeof(OptlyFlagValue), OPTLY_ALIGNOF(OptlyValues));
+
+  return size + positionals_count * sizeof(OptlyValues);
+}
+
+static size_t optly__result_size(const OptlyCommand *cmd) {
+  size_t offsets[4];
+  size_t size    = optly__level_layout(cmd, offsets) + OPTLY_CACHE_LINE - 1;
+  size_t deepest = 0;
+
+  // NOTE: Masks are built in result arena if command wasn't compiled
+  if (!cmd->index || !cmd->index->masks) {
+    size += optly__masks_size(cmd) + OPTLY_ALIGNOF(uint64_t) - 1;
+  }
+
+  for (const OptlyCommand *sub = cmd->commands; !optly_is_command_null(sub); sub++) {
+    size_t sub_size = optly__result_size(sub);
+    deepest         = sub_size > deepest ? sub_size : deepest;
+  }
+
+  return size + deepest;
+}
+
+OPTLYDEF size_t optly_result_size(const OptlyCommand *schema) {
+  return optly__result_size(schema);
+}
+
+static bool optly__enter_command(OptlyParser *p, const OptlyCommand *cmd) {
+  OptlyArena *arena = &p->result->arena;
+
+  size_t flags_count       = cmd->flags ? optly__flags_count(cmd->flags) : 0;
+  size_t positionals_count = optly__positionals_count(cmd->positionals);
+
+  size_t         offsets[4];
+  size_t         size  = optly__level_layout(cmd, offsets);
+  unsigned char *block = optly_arena_alloc(arena, size, OPTLY_CACHE_LINE);
+
+  if (!block) {
+    optly__out_of_memory(p, cmd->name);
+    return false;
+  }
+
+  memset(block, 0, size);
+
+  OptlyResultCommand *level       = (OptlyResultCommand *)block;
+  uint64_t           *bools       = (uint64_t *)(block + offsets[0]);
+  uint64_t           *present     = (uint64_t *)(block + offsets[1]);
+  OptlyFlagValue     *values      = (OptlyFlagValue *)(block + offsets[2]);
+  OptlyValues        *positionals = (OptlyValues *)(block + offsets[3]);
+
+  for (size_t i = 0; i < flags_count; i++) {
+    const OptlyFlag *flag = &cmd->flags[i];
+
+    values[i] = flag->value;
+
+    if (flag->type == OPTLY_TYPE_BOOL && flag->value.as_bool) {
+      optly__set_bit(bools, i);
+    }
+
+    // NOTE: Default is pointed at in candidates list too, so its position is known without lookups later
+    if (flag->type == OPTLY_TYPE_ENUM && flag->value.as_enum && flag->value.as_enum[0]) {
+      char **match = optly__enum_find(cmd, flag, flag->value.as_enum[0]);
+      values[i].as_enum = match ? match : flag->value.as_enum;
+    }
+
+    if (flag->list) {
+      values[i].as_list = flag->list;
+    }
+  }
+
+  *level = (OptlyResultCommand){cmd, values, present, positionals, NULL, bools};
+
+  if (p->level) {
+    optly__finish_positionals(p);
+    p->level->next = level;
+  } else {
+    p->result->commands = level;
+  }
+
+  if (p->slots) {
+    p->slots += p->run_count;
+  }
+
+  size_t last = positionals_count - 1;
+
+  p->stream       = NULL;
+  p->stream_after = 0;
+
+  if (positionals_count > 0 && cmd->positionals[last].on_value && cmd->positionals[last].max == 0) {
+    p->stream = &cmd->positionals[last];
+
+    for (size_t i = 0; i < last; i++) {
+      p->stream_after += cmd->positionals[i].min == 0 ? 1 : cmd->positionals[i].min;
+    }
+  }
+
+  p->level        = level;
+  p->run          = p->slots;
+  p->run_count    = 0;
+  p->run_capacity = p->slots ? SIZE_MAX : 0;
+
+  return true;
+}
+
+static void optly__bind(const OptlyFlag *flag, const OptlyFlagValue *value) {
+  const OptlyFlagBind *bind = &flag->bind;
+
+  switch (flag->type) {
+    case OPTLY_TYPE_BOOL:   *bind->as_bool = value->as_bool; break;
+    case OPTLY_TYPE_CHAR:   *bind->as_char = value->as_char; break;
+    case OPTLY_TYPE_STRING: *bind->as_string = value->as_string; break;
+    case OPTLY_TYPE_INT8:   *bind->as_int8 = value->as_int8; break;
+    case OPTLY_TYPE_INT16:  *bind->as_int16 = value->as_int16; break;
+    case OPTLY_TYPE_INT32:  *bind->as_int32 = value->as_int32; break;
+    case OPTLY_TYPE_INT64:  *bind->as_int64 = value->as_int64; break;
+    case OPTLY_TYPE_UINT8:  *bind->as_uint8 = value->as_uint8; break;
+    case OPTLY_TYPE_UINT16: *bind->as_uint16 = value->as_uint16; break;
+    case OPTLY_TYPE_UINT32: *bind->as_uint32 = value->as_uint32; break;
+    case OPTLY_TYPE_UINT64: *bind->as_uint64 = value->as_uint64; break;
+    case OPTLY_TYPE_FLOAT:  *bind->as_float = value->as_float; break;
+    case OPTLY_TYPE_DOUBLE: *bind->as_double = value->as_double; break;
+    case OPTLY_TYPE_ENUM:   *bind->as_enum = value->as_enum[0]; break;
+
+    case OPTLY_TYPE_SIZE:     *bind->as_uint64 = value->as_uint64; break;
+    case OPTLY_TYPE_DURATION: *bind->as_int64 = value->as_int64; break;
+    case OPTLY_TYPE_RATE:     *bind->as_double = value->as_double; break;
+    case OPTLY_TYPE_CPUSET:   *bind->as_cpuset = *value->as_cpuset; break;
+    case OPTLY_TYPE_CUSTOM:   memcpy(bind->as_custom, value->as_custom, flag->converter->size); break;
+  }
+}
+
+/**
+ * Convert every part of list flag value and append it. Elements are copied out of
+ * the union, so list is one contiguous typed array growing in place at arena top.
+ * List of schema is never grown, it has capacity caller gave it.
+ */
+static void optly__append_list(OptlyParser *p, const OptlyFlag *flag, OptlyList *list, char *value) {
+  OptlyArena *arena = &p->result->arena;
+  size_t      size  = optly__value_size(flag->type);
+  char       *part  = value;
+
+  do {
+    char *next = part && flag->separator ? strchr(part, flag->separator) : NULL;
+
+    if (next) {
+      *next++ = '\0';
+    }
+
+    OptlyFlagValue parsed;
+
+    if (optly__flag_set_value(p->level->command, flag, &parsed, part, arena, &p->result->errors)) {
+      if (list->count == list->capacity && p->in_schema) {
+        OPTLY_LOG(ERROR, "List of %s can't hold more than %zu values", flag->fullname, list->capacity);
+        optly__push_error(&p->result->errors, OPTLY_ERR_OUT_OF_MEMORY, flag->fullname);
+        p->out_of_memory = true;
+        return;
+      }
+
+      if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 8;
+        void  *items    = optly__arena_grow(arena, list->items, list->capacity * size, capacity * size, size);
+
+        if (!items) {
+          optly__out_of_memory(p, flag->fullname);
+          return;
+        }
+
+        list->items    = items;
+        list->capacity = capacity;
+      }
+
+      memcpy((unsigned char *)list->items + list->count * size, &parsed, size);
+      list->count++;
+    }
+
+    part = next;
+  } while (part);
+}
+
+/**
+ * Bool flag needs no conversion, so it is just two bits and value.
+ */
+static void optly__set_bool(OptlyParser *p, const OptlyFlag *flag) {
+  size_t i = (size_t)(flag - p->level->command->flags);
+
+  optly__set_bit(p->level->present, i);
+  optly__set_bit(p->level->bools, i);
+  p->level->values[i].as_bool = true;
+
+  if (flag->bind.as_bool) {
+    *flag->bind.as_bool = true;
+  }
+}
+
+static void optly__set_flag(OptlyParser *p, const OptlyFlag *flag, char *value) {
+  size_t i = (size_t)(flag - p->level->command->flags);
+
+  if (flag->type == OPTLY_TYPE_BOOL && !flag->list) {
+    optly__set_bool(p, flag);
+    return;
+  }
+
+  if (flag->list) {
+    // NOTE: Until first occurrence result shows schema list as default
+    if (!optly__bit(p->level->present, i)) {
+      OptlyList *list = p->in_schema ? flag->list : optly_arena_alloc(&p->result->arena, sizeof(*list), OPTLY_ALIGNOF(OptlyList));
+
+      if (!list) {
+        optly__out_of_memory(p, flag->fullname);
+        return;
+      }
+
+      if (p->in_schema) {
+        list->count = 0;
+      } else {
+        *list = (OptlyList){0};
+      }
+
+      p->level->values[i].as_list = list;
+      optly__set_bit(p->level->present, i);
+    }
+
+    optly__append_list(p, flag, p->level->values[i].as_list, value);
+    return;
+  }
+
+  optly__set_bit(p->level->present, i);
+
+  if (optly__flag_set_value(p->level->command, flag, &p->level->values[i], value, &p->result->arena, &p->result->errors) && flag->bind.as_any) {
+    optly__bind(flag, &p->level->values[i]);
+  }
+}
+
+static const OptlyFlag *optly__find_short_flag(char shortname, const OptlyCommand *cmd) {
+  if (cmd->index) {
+    return optly__index_short(cmd, shortname);
+  }
+
+  for (const OptlyFlag *f = cmd->flags; !optly_is_flag_null(f); f++) {
+    if (f->shortname == shortname) {
+      return f;
+    }
+  }
+
+  return NULL;
+}
+
+static void optly__parse_batch_flags(OptlyParser *p, const OptlyToken *token) {
+  char *arg = token->arg;
+
+  if (token->eq != token->len) {
+    return;
+  }
+
+  OptlyErrors *errs = &p->result->errors;
+
+  for (char *c = &arg[1]; *c; c++) {
+    const OptlyFlag *flag = optly__find_short_flag(*c, p->level->command);
+
+    if (!flag) {
+      OPTLY_LOG(WARN, "Unknown short flag: -%c", *c);
+      optly__push_error(errs, OPTLY_ERR_UNKNOWN_FLAG, arg);
+
+      continue;
+    }
+
+    if (flag->type != OPTLY_TYPE_BOOL) {
+      OPTLY_LOG(WARN, "cannot batch non-boolean flags (invalid flag -%c in %s)", *c, arg);
+      optly__push_error(errs, OPTLY_ERR_BATCH_NON_BOOL, &flag->shortname);
+      continue;
+    }
+
+    optly__set_flag(p, flag, NULL);
+  }
+
+  return;
+}
+
+static void optly__parse_long_flags(OptlyParser *p, const OptlyToken *token) {
+  char *arg   = token->arg;
+  char *value = token->eq != token->len ? arg + token->eq + 1 : NULL;
+
+  // NOTE: Name is matched on its length right inside of the token, nothing is copied
+  const OptlyFlag *flag = optly__find_flag(arg, token->eq, p->level->command);
+
+  if (!flag) {
+    OPTLY_LOG(WARN, "Unknown flag: %.*s", (int)token->eq, arg);
+    optly__push_error(&p->result->errors, OPTLY_ERR_UNKNOWN_FLAG, arg);
+    return;
+  }
+
+  if (!value && flag->type != OPTLY_TYPE_BOOL) {
+    // NOTE: Value comes with the next token
+    p->pending = flag;
+    return;
+  }
+
+  optly__set_flag(p, flag, value);
+}
+
+/**
+ * Parse flags from token.
+ */
+static void optly__parse_flags(OptlyParser *p, const OptlyToken *token) {
+  if (token->kind == OPTLY__TOKEN_BATCH) {
+    optly__parse_batch_flags(p, token);
+  } else {
+    optly__parse_long_flags(p, token);
+  }
+}
+
+/**
+ * Parse a command from argv. Lazy commands are built by their provider here.
+ * Returns true if token names a subcommand, `cmd` is NULL if its provider failed
+ * (that is reported already).
+ */
+static bool optly__parse_command(const OptlyToken *token, const OptlyCommand *parent, OptlyErrors *errs, const OptlyCommand **cmd) {
+  const char         *arg   = token->arg;
+  const OptlyCommand *found = NULL;
+
+  if (parent->index && parent->index->match_command) {
+    uint32_t i = parent->index->match_command(arg, token->len);
+
+    found = i ? &parent->commands[i - 1] : NULL;
+  } else if (parent->index) {
+    const OptlyIndex     *index = parent->index;
+    const OptlyIndexSlot *slot  = optly__index_find(index->commands, index->commands_mask, arg, token->len);
+
+    found = slot ? &parent->commands[slot->index - 1] : NULL;
+  } else {
+    for (const OptlyCommand *cmd = parent->commands; !optly_is_command_null(cmd); cmd++) {
+      if (strcmp(arg, cmd->name) == 0) {
+        found = cmd;
+        break;
+      }
+    }
+  }
+
+  *cmd = found;
+
+  if (!found || !found->provider) {
+    return found != NULL;
+  }
+
+  *cmd = found->provider(found);
+
+  if (!*cmd) {
+    OPTLY_LOG(ERROR, "Command '%s' could not be loaded", arg);
+    optly__push_error(errs, OPTLY_ERR_UNKNOWN_COMMAND, arg);
+  }
+
+  return true;
+}
+
+/**
+ * Append values to positionals of current command. Distribution happens once
+ * command is finished.
+ */
+static void optly__store_positionals(OptlyParser *p, char **values, size_t count) {
+  if (count == 0) {
+    return;
+  }
+
+  if (count > p->run_capacity - p->run_count) {
+    size_t capacity = p->run_capacity ? p->run_capacity * 2 : 8;
+
+    if (capacity < p->run_count + count) {
+      capacity = p->run_count + count;
+    }
+
+    char **run = optly__arena_grow(&p->result->arena, p->run, p->run_capacity * sizeof(*run), capacity * sizeof(*run), OPTLY_ALIGNOF(char *));
+
+    if (!run) {
+      optly__out_of_memory(p, values[0]);
+      return;
+    }
+
+    p->run          = run;
+    p->run_capacity = capacity;
+  }
+
+  char **dst = p->run + p->run_count;
+
+  if (p->slots) {
+    // NOTE: Values are swapped with whatever they are moved over, so argv stays
+    //       a permutation of itself: one step at a time, overlap is fine
+    for (size_t i = 0; i < count; i++) {
+      char *moved = dst[i];
+      dst[i]      = values[i];
+      values[i]   = moved;
+    }
+  } else {
+    memmove(dst, values, count * sizeof(*values));
+  }
+
+  p->run_count += count;
+}
+
+/**
+ * Positional values are taken right from argv, so callback knows where they came from.
+ */
+static void optly__push_positionals(OptlyParser *p, char **values, size_t count) {
+  const OptlyPositional *defs = p->level->command->positionals;
+
+  if (!defs || !defs->name || count == 0) return;
+
+  if (!p->stream) {
+    optly__store_positionals(p, values, count);
+    return;
+  }
+
+  // NOTE: Last positional takes everything once others have their minimum, so
+  //       from there on values can go straight to the callback
+  size_t stored = p->stream_after > p->run_count ? p->stream_after - p->run_count : 0;
+
+  if (stored > count) {
+    stored = count;
+  }
+
+  optly__store_positionals(p, values, stored);
+
+  OptlyValues *streamed = &p->level->positionals[optly__positionals_count(defs) - 1];
+
+  for (size_t i = stored; i < count; i++) {
+    p->stream->on_value(p->level->command, values[i], (int)(p->index + i), p->stream->ctx);
+  }
+
+  streamed->count += count - stored;
+}
+
+static unsigned optly__popcount(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return (unsigned)__builtin_popcountll(x);
+#else
+  unsigned count = 0;
+
+  for (; x; x &= x - 1) {
+    count++;
+  }
+
+  return count;
+#endif
+}
+
+static unsigned optly__ctz(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return (unsigned)__builtin_ctzll(x);
+#else
+  unsigned count = 0;
+
+  for (; !(x & 1); x >>= 1) {
+    count++;
+  }
+
+  return count;
+#endif
+}
+
+static bool optly__group_ok(OptlyGroupKind kind, const uint64_t *present, const uint64_t *members, const uint64_t *trigger, size_t words) {
+  unsigned hits      = 0;
+  bool     all       = true;
+  bool     triggered = false;
+
+  for (size_t w = 0; w < words; w++) {
+    uint64_t given = present[w] & members[w];
+
+    hits += optly__popcount(given);
+    all       = all && given == members[w];
+    triggered = triggered || (present[w] & trigger[w]);
+  }
+
+  switch (kind) {
+    case OPTLY_GROUP_EXCLUSIVE:   return hits <= 1;
+    case OPTLY_GROUP_ONE_OF:      return hits == 1;
+    case OPTLY_GROUP_ANY_OF:      return hits >= 1;
+    case OPTLY_GROUP_ALL_OR_NONE: return hits == 0 || all;
+    case OPTLY_GROUP_REQUIRES:    return !triggered || all;
+  }
+
+  return true;
+}
+
+/**
+ * Required flags and constraint groups are checked on bitmasks, word at a time.
+ * Compiled command has masks ready, otherwise they are built in parse arena.
+ */
+static void optly__validate_flags(OptlyParser *p, const OptlyResultCommand *level) {
+  const OptlyCommand *cmd   = level->command;
+  OptlyErrors        *errs  = &p->result->errors;
+  size_t              words = optly__mask_words(cmd);
+  uint64_t           *masks = cmd->index ? cmd->index->masks : NULL;
+
+  if (!masks) {
+    masks = optly_arena_alloc(&p->result->arena, optly__masks_size(cmd), OPTLY_ALIGNOF(uint64_t));
+
+    if (!masks) {
+      optly__out_of_memory(p, cmd->name);
+      return;
+    }
+
+    if (!optly__build_masks(cmd, masks)) {
+      optly__push_error(errs, OPTLY_ERR_CONSTRAINT, cmd->name);
+      return;
+    }
+  }
+
+  for (size_t w = 0; w < words; w++) {
+    for (uint64_t missing = masks[w] & ~level->present[w]; missing; missing &= missing - 1) {
+      const OptlyFlag *flag = &cmd->flags[w * 64 + optly__ctz(missing)];
+
+      OPTLY_LOG(ERROR, "Required flag '--%s' is not present", flag->fullname);
+      optly__push_error(errs, OPTLY_ERR_MISSING_REQUIRED, flag->fullname);
+    }
+  }
+
+  for (size_t g = 0; cmd->groups && cmd->groups[g].flags; g++) {
+    const OptlyGroup *group   = &cmd->groups[g];
+    const uint64_t   *members = masks + (1 + 2 * g) * words;
+
+    if (!optly__group_ok(group->kind, level->present, members, members + words, words)) {
+      const char *name = group->name ? group->name : group->flags[0];
+
+      OPTLY_LOG(ERROR, "Flags of group '%s' don't satisfy its constraint", name);
+      optly__push_error(errs, OPTLY_ERR_CONSTRAINT, name);
+    }
+  }
+}
+
+static void optly__validate_positionals(const OptlyResultCommand *level, OptlyErrors *errs) {
+  const OptlyPositional *defs = level->command->positionals;
+
+  if (!defs) {
+    return;
+  }
+
+  bool infinite_found = false;
+
+  for (size_t i = 0; defs[i].name; i++) {
+    const OptlyPositional *pos   = &defs[i];
+    size_t                 count = level->positionals[i].count;
+
+    if (pos->max == 0) {
+      if (infinite_found) {
+        OPTLY_LOG(FATAL, "Positional '%s' allows infinite values, but another variadic positional already exists", pos->name);
+        optly__push_error(errs, OPTLY_ERR_DUPLICATE_VARIADIC, pos->name);
+      }
+
+      infinite_found = true;
+    }
+
+    if (count < pos->min) {
+      OPTLY_LOG(ERROR, "Not enough values for positional '%s'", pos->name);
+      optly__push_error(errs, OPTLY_ERR_POSITIONAL_TOO_FEW, pos->name);
+    }
+
+    if (pos->max != 0 && count > pos->max) {
+      OPTLY_LOG(ERROR, "Too many values for positional '%s'", pos->name);
+      optly__push_error(errs, OPTLY_ERR_POSITIONAL_TOO_MANY, pos->name);
+    }
+  }
+}
+
+OPTLYDEF bool optly_is_command(OptlyCommand *command, const char *name) {
+  return command && strcmp(command->name, name) == 0;
+}
+
+OPTLYDEF const OptlyFlag *optly_get_flag(const OptlyFlag *flags, const char *name) {
+  for (const OptlyFlag *flag = flags; !optly_is_flag_null(flag); flag++) {
+    if (flag->fullname && strcmp(flag->fullname, name) == 0) {
+      return flag;
+    }
+  }
+
+  return NULL;
+}
+
+OPTLYDEF bool optly_flag_value_bool(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_bool : false;
+}
+
+OPTLYDEF char optly_flag_value_char(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_char : '\0';
+}
+
+OPTLYDEF char *optly_flag_value_string(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_string : "";
+}
+
+OPTLYDEF int8_t optly_flag_value_int8(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_int8 : 0;
+}
+
+OPTLYDEF int16_t optly_flag_value_int16(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_int16 : 0;
+}
+
+OPTLYDEF int32_t optly_flag_value_int32(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_int32 : 0;
+}
+
+OPTLYDEF int64_t optly_flag_value_int64(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_int64 : 0;
+}
+
+OPTLYDEF uint8_t optly_flag_value_uint8(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_uint8 : 0;
+}
+
+OPTLYDEF uint16_t optly_flag_value_uint16(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_uint16 : 0;
+}
+
+OPTLYDEF uint32_t optly_flag_value_uint32(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_uint32 : 0;
+}
+
+OPTLYDEF uint64_t optly_flag_value_uint64(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_uint64 : 0;
+}
+
+OPTLYDEF float optly_flag_value_float(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_float : 0;
+}
+
+OPTLYDEF double optly_flag_value_double(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_double : 0;
+}
+
+OPTLYDEF char *optly_flag_value_enum(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_enum[0] : NULL;
+}
+
+OPTLYDEF uint32_t optly_flag_value_enum_index(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->enum_index : OPTLY_ENUM_NONE;
+}
+
+OPTLYDEF uint64_t optly_flag_value_size(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_uint64 : 0;
+}
+
+OPTLYDEF int64_t optly_flag_value_duration(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_int64 : 0;
+}
+
+OPTLYDEF double optly_flag_value_rate(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_double : 0;
+}
+
+OPTLYDEF OptlyCpuSet *optly_flag_value_cpuset(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_cpuset : NULL;
+}
+
+OPTLYDEF void *optly_flag_value_custom(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->value.as_custom : NULL;
+}
+
+OPTLYDEF OptlyList *optly_flag_value_list(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? flag->list : NULL;
+}
+
+OPTLYDEF OptlyHandle optly_flag_handle(const OptlyCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command, name);
+  return flag ? (OptlyHandle)(flag - command->flags) : OPTLY_NO_HANDLE;
+}
+
+OPTLYDEF OptlyHandle optly_positional_handle(const OptlyCommand *command, const char *name) {
+  for (size_t i = 0; command->positionals && command->positionals[i].name; i++) {
+    if (strcmp(command->positionals[i].name, name) == 0) {
+      return i;
+    }
+  }
+
+  return OPTLY_NO_HANDLE;
+}
+
+OPTLYDEF OptlyPositional *optly_get_positional(OptlyCommand *command, const char *name) {
+  OptlyHandle handle = optly_positional_handle(command, name);
+  return handle != OPTLY_NO_HANDLE ? &command->positionals[handle] : NULL;
+}
+
+OPTLYDEF bool optly_result_has(const OptlyResultCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command->command, name);
+  return flag && optly__bit(command->present, (size_t)(flag - command->command->flags));
+}
+
+OPTLYDEF OptlyFlagValue optly_result_value(const OptlyResultCommand *command, const char *name) {
+  const OptlyFlag *flag = optly__lookup_flag(command->command, name);
+
+  if (!flag) {
+    return (OptlyFlagValue){.as_int64 = 0};
+  }
+
+  return command->values[flag - command->command->flags];
+}
+
+OPTLYDEF const OptlyValues *optly_result_positional(const OptlyResultCommand *command, const char *name) {
+  OptlyHandle handle = optly_positional_handle(command->command, name);
+  return handle != OPTLY_NO_HANDLE ? &command->positionals[handle] : NULL;
+}
+
+/**
+ * Handle one token. `slot` points at it in argv (or anywhere else), so positional
+ * values can be moved without touching strings.
+ */
+static void optly__feed(OptlyParser *p, char **slot) {
+  char        *arg   = *slot;
+  OptlyErrors *errs  = &p->result->errors;
+  OptlyToken   token = optly__classify(arg);
+
+  const OptlyCommand *current_cmd = p->level->command;
+
+  if (p->stopped) {
+    return;
+  }
+
+  if (p->pending) {
+    const OptlyFlag *flag = p->pending;
+    p->pending            = NULL;
+
+    if (token.kind == OPTLY__TOKEN_VALUE) {
+      optly__set_flag(p, flag, arg);
+      return;
+    }
+
+    optly__set_flag(p, flag, NULL);
+  }
+
+  if (p->positional_only) {
+    optly__push_positionals(p, slot, 1);
+    return;
+  }
+
+#ifdef OPTLY_GEN_HELP_COMMAND
+  if (p->help) {
+    const OptlyCommand *target = NULL;
+
+    if (!optly__parse_command(&token, current_cmd, errs, &target)) {
+      OPTLY_LOG(ERROR, "Unknown command: %s", arg);
+      optly__push_error(errs, OPTLY_ERR_UNKNOWN_COMMAND, arg);
+    }
+
+    p->result->help = target;
+    p->stopped      = true;
+    return;
+  }
+#endif
+
+#ifdef OPTLY_GEN_HELP_FLAG
+  if (optly__is_help_flag(&token)) {
+    p->result->help = current_cmd;
+    p->stopped      = true;
+    return;
+  }
+#endif
+
+#ifdef OPTLY_GEN_VERSION_FLAG
+  if (optly__is_version_flag(&token)) {
+    p->result->version = true;
+    p->stopped         = true;
+    return;
+  }
+#endif
+
+  if (token.kind == OPTLY__TOKEN_DELIMITER) {
+    p->positional_only = true;
+    return;
+  }
+
+  if (token.kind != OPTLY__TOKEN_VALUE) {
+    if (current_cmd->flags) {
+      optly__parse_flags(p, &token);
+    } else {
+      // '--flag' argument is positional if no flags defined
+      optly__push_positionals(p, slot, 1);
+    }
+
+    return;
+  }
+
+#ifdef OPTLY_GEN_HELP_COMMAND
+  if (strcmp(arg, "help") == 0) {
+    p->help = true;
+    return;
+  }
+#endif
+
+#ifdef OPTLY_GEN_VERSION_COMMAND
+  if (strcmp(arg, "version") == 0) {
+    p->result->version = true;
+    p->stopped         = true;
+    return;
+  }
+#endif
+
+  const OptlyCommand *cmd = NULL;
+
+  if (optly__parse_command(&token, current_cmd, errs, &cmd)) {
+    // NOTE: Provider failure is reported already, name is not a positional either
+    if (cmd) {
+      optly__enter_command(p, cmd);
+    }
+  } else if (current_cmd->positionals) {
+    optly__push_positionals(p, slot, 1);
+  } else {
+    OPTLY_LOG(ERROR, "Unknown command %s", arg);
+    optly__push_error(errs, OPTLY_ERR_UNKNOWN_COMMAND, arg);
+  }
+}
+
+static void optly__init(OptlyParser *p, const OptlyCommand *schema, OptlyResult *result, const char *name, const char *version, char **slots) {
+  result->arena.used = 0;
+  result->commands   = NULL;
+  result->help       = NULL;
+  result->version    = false;
+
+  *p = (OptlyParser){.result = result, .main = schema, .name = name, .version = version, .slots = slots};
+
+  optly__enter_command(p, schema);
+}
+
+static void optly__parse(OptlyParser *p, int argc, char *argv[]) {
+  for (int i = 1; i < argc && argv[i] && !p->out_of_memory && !p->stopped; i++) {
+    p->index = (size_t)i;
+
+    if (p->positional_only) {
+      // NOTE: Everything after '--' is positional, take it at once
+      size_t count = 0;
+      while (count < (size_t)(argc - i) && argv[i + count]) count++;
+
+      optly__push_positionals(p, &argv[i], count);
+      break;
+    }
+
+    optly__feed(p, &argv[i]);
+  }
+
+  optly_parser_finish(p);
+}
+
+#if defined(OPTLY_GEN_VERSION_FLAG) || defined(OPTLY_GEN_VERSION_COMMAND)
+OPTLYDEF void optly_parser_init(OptlyParser *parser, const OptlyCommand *schema, OptlyResult *result, const char *version) {
+#else
+OPTLYDEF void optly_parser_init(OptlyParser *parser, const OptlyCommand *schema, OptlyResult *result) {
+  const char *version = NULL;
+#endif
+  result->errors.count = 0;
+  optly__init(parser, schema, result, schema->name ? schema->name : "", version, NULL);
+}
+
+/**
+ * Returns false if token added errors. Flag that needs a value takes next token,
+ * so its errors show up one token later.
+ */
+OPTLYDEF bool optly_parser_feed(OptlyParser *parser, char *token) {
+  if (parser->out_of_memory || !token) {
+    return false;
+  }
 
-    if (cmd) {
-      current_cmd->next_command = cmd;
-      current_cmd               = current_cmd->next_command;
-    } else {
-      if (current_cmd->positionals) {
-        optly__push_positional(current_cmd, arg);
+  size_t errors = parser->result->errors.count;
+
+  parser->index++;
+  optly__feed(parser, &token);
+
+  return parser->result->errors.count == errors;
+}
+
+OPTLYDEF bool optly_parser_finish(OptlyParser *parser) {
+  OptlyErrors *errs = &parser->result->errors;
+
+  if (!parser->level) {
+    return false;
+  }
+
+  if (parser->pending) {
+    optly__set_flag(parser, parser->pending, NULL);
+    parser->pending = NULL;
+  }
+
+#ifdef OPTLY_GEN_HELP_COMMAND
+  if (parser->help && !parser->stopped) {
+    parser->result->help = parser->level->command;
+    parser->stopped      = true;
+  }
+#endif
+
+  // NOTE: Nothing is validated once help or version was asked for
+  if (parser->stopped) {
+    return errs->count == 0;
+  }
+
+  optly__finish_positionals(parser);
+
+  for (const OptlyResultCommand *level = parser->result->commands; level; level = level->next) {
+    optly__validate_flags(parser, level);
+    optly__validate_positionals(level, errs);
+  }
+
+  return errs->count == 0;
+}
+
+#if defined(OPTLY_GEN_VERSION_FLAG) || defined(OPTLY_GEN_VERSION_COMMAND)
+OPTLYDEF bool optly_parse(const OptlyCommand *schema, int argc, char *argv[], OptlyResult *result, const char *version) {
+#else
+OPTLYDEF bool optly_parse(const OptlyCommand *schema, int argc, char *argv[], OptlyResult *result) {
+  const char *version = NULL;
+#endif
+  assert(argc > 0);
+
+  result->errors.count = 0;
+
+  OptlyParser p;
+  optly__init(&p, schema, result, schema->name ? schema->name : argv[0], version, NULL);
+  optly__parse(&p, argc, argv);
+
+  return result->errors.count == 0;
+}
+
+typedef struct OptlyBatchJob {
+  const OptlyCommand *schema;
+  const OptlyArgv    *inputs;
+  size_t              count;
+  OptlyResult        *out;
+  const OptlyBatch   *batch;
+
+  size_t scratch;  // Bytes of result each worker validates into when there is no `out`
+
+  size_t next;  // First item nobody took yet
+  size_t failed;
+
+#ifdef OPTLY_THREADS
+  pthread_mutex_t lock;
+#endif
+} OptlyBatchJob;
+
+#ifdef OPTLY_THREADS
+#define OPTLY_BATCH_LOCK(job)   pthread_mutex_lock(&(job)->lock)
+#define OPTLY_BATCH_UNLOCK(job) pthread_mutex_unlock(&(job)->lock)
+#else
+#define OPTLY_BATCH_LOCK(job)
+#define OPTLY_BATCH_UNLOCK(job)
+#endif
+
+static double optly__now(void) {
+#ifdef OPTLY_THREADS
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#else
+  // NOTE: CPU time, same as wall time for single thread busy parsing
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/**
+ * Take next chunk of items. Workers that finish early just take more, so slow
+ * items don't hold the others back.
+ */
+static bool optly__batch_take(OptlyBatchJob *job, size_t *begin, size_t *end) {
+  OPTLY_BATCH_LOCK(job);
+
+  *begin    = job->next;
+  *end      = job->count - *begin > OPTLY_BATCH_CHUNK ? *begin + OPTLY_BATCH_CHUNK : job->count;
+  job->next = *end;
+
+  OPTLY_BATCH_UNLOCK(job);
+  return *begin < *end;
+}
+
+static void *optly__batch_worker(void *arg) {
+  OptlyBatchJob *job    = arg;
+  size_t         failed = 0;
+  size_t         begin, end;
+
+  // NOTE: Without `out` results are only validated, every item reuses this one
+  unsigned char buf[job->out ? 1 : job->scratch];
+  OptlyResult   scratch = optly_result(buf, sizeof(buf));
+
+  while (optly__batch_take(job, &begin, &end)) {
+    for (size_t i = begin; i < end; i++) {
+      const OptlyArgv *in  = &job->inputs[i];
+      OptlyResult     *res = job->out ? &job->out[i] : &scratch;
+
+      assert(in->argc > 0);
+
+      OptlyParser p;
+      res->errors.count = 0;
+      optly__init(&p, job->schema, res, job->schema->name ? job->schema->name : in->argv[0], NULL, NULL);
+      optly__parse(&p, in->argc, in->argv);
+
+      if (res->errors.count == 0) continue;
+
+      failed++;
+
+      if (job->batch && job->batch->on_error) {
+        for (size_t e = 0; e < res->errors.count; e++) {
+          job->batch->on_error(job->batch->ctx, i, &res->errors.items[e]);
+        }
+      }
+    }
+  }
+
+  OPTLY_BATCH_LOCK(job);
+  job->failed += failed;
+  OPTLY_BATCH_UNLOCK(job);
+
+  return NULL;
+}
+
+OPTLYDEF bool optly_parse_batch(const OptlyCommand *schema, const OptlyArgv *inputs, size_t count, OptlyResult *out, size_t threads, OptlyBatch *batch) {
+  OptlyBatchJob job   = {.schema = schema, .inputs = inputs, .count = count, .out = out, .batch = batch};
+
+  // NOTE: Selected commands always fit, positional values and lists get the rest
+  job.scratch = optly_result_size(schema) + OPTLY_PARSE_BUFFER_LENGTH;
+  double        start = optly__now();
+
+#ifdef OPTLY_THREADS
+  pthread_t workers[OPTLY_BATCH_MAX_THREADS];
+  size_t    spawned = 0;
+
+  pthread_mutex_init(&job.lock, NULL);
+
+  // NOTE: Calling thread is a worker too
+  for (; spawned + 1 < threads && spawned + 1 < OPTLY_BATCH_MAX_THREADS; spawned++) {
+    if (pthread_create(&workers[spawned], NULL, optly__batch_worker, &job) != 0) {
+      break;
+    }
+  }
+
+  optly__batch_worker(&job);
+
+  for (size_t i = 0; i < spawned; i++) {
+    pthread_join(workers[i], NULL);
+  }
+
+  pthread_mutex_destroy(&job.lock);
+#else
+  (void)threads;
+  optly__batch_worker(&job);
+#endif
+
+  double seconds = optly__now() - start;
+
+  if (batch) {
+    batch->failed     = job.failed;
+    batch->seconds    = seconds;
+    batch->per_second = seconds > 0 ? (double)count / seconds : 0;
+  }
+
+  return job.failed == 0;
+}
+
+/**
+ * Split text into tokens in place. Whitespace separates tokens, '...' and "..."
+ * group them, backslash escapes next character (except inside '...').
+ * Token can only shrink, so it's written over itself and NUL terminated there.
+ * Stops after `max` tokens, `rest` (if not NULL) gets what is left.
+ */
+static size_t optly__tokenize(char *text, char **tokens, size_t max, char **rest, char **unclosed) {
+  size_t count = 0;
+  char  *r     = text;
+  char  *w     = text;
+
+  for (;;) {
+    while (*r == ' ' || *r == '\t' || *r == '\n' || *r == '\r') r++;
+    if (!*r || count == max) break;
+
+    tokens[count++] = w;
+    char quote      = 0;
+
+    while (*r && (quote || (*r != ' ' && *r != '\t' && *r != '\n' && *r != '\r'))) {
+      if (quote && *r == quote) {
+        quote = 0;
+        r++;
+      } else if (!quote && (*r == '\'' || *r == '"')) {
+        quote = *r++;
+      } else {
+        if (*r == '\\' && quote != '\'' && r[1]) r++;
+        *w++ = *r++;
+      }
+    }
+
+    if (quote && unclosed && !*unclosed) {
+      *unclosed = tokens[count - 1];
+    }
+
+    // NOTE: Step over separator before terminating, `w` may point right at it
+    if (*r) r++;
+    *w++ = '\0';
+  }
+
+  if (rest) {
+    *rest = r;
+  }
+
+  return count;
+}
+
+/**
+ * Line holds only arguments, schema name is put in front of them. `argv` needs
+ * room for name, every token and terminating NULL.
+ */
+#if defined(OPTLY_GEN_VERSION_FLAG) || defined(OPTLY_GEN_VERSION_COMMAND)
+OPTLYDEF bool optly_parse_line(const OptlyCommand *schema, char *line, char *argv[], size_t capacity, OptlyResult *result, const char *version) {
+#else
+OPTLYDEF bool optly_parse_line(const OptlyCommand *schema, char *line, char *argv[], size_t capacity, OptlyResult *result) {
+#endif
+  assert(capacity > 1);
+
+  char  *rest     = NULL;
+  char  *unclosed = NULL;
+  size_t count    = optly__tokenize(line, argv + 1, capacity - 2, &rest, &unclosed);
+
+  argv[0]         = schema->name ? schema->name : "";
+  argv[count + 1] = NULL;
+
+  if (*rest || unclosed) {
+    result->arena.used   = 0;
+    result->errors.count = 0;
+    result->commands     = NULL;
+    result->help         = NULL;
+    result->version      = false;
+  }
+
+  if (*rest) {
+    OPTLY_LOG(ERROR, "Too many arguments in line, only %zu fit", count);
+    optly__push_error(&result->errors, OPTLY_ERR_OUT_OF_MEMORY, rest);
+    return false;
+  }
+
+  if (unclosed) {
+    OPTLY_LOG(ERROR, "Quote is not closed in '%s'", unclosed);
+    optly__push_error(&result->errors, OPTLY_ERR_UNCLOSED_QUOTE, unclosed);
+    return false;
+  }
+
+#if defined(OPTLY_GEN_VERSION_FLAG) || defined(OPTLY_GEN_VERSION_COMMAND)
+  return optly_parse(schema, (int)count + 1, argv, result, version);
+#else
+  return optly_parse(schema, (int)count + 1, argv, result);
+#endif
+}
+
+#ifdef OPTLY_RESPONSE_FILES
+/**
+ * Map file privately with writable zero page right after it, so tokens can be
+ * terminated in place even if file ends exactly on a page boundary. Room for
+ * token pointers goes after that.
+ */
+static void optly__map_response_file(OptlyResponseFile *file, const char *path, OptlyErrors *errs) {
+  *file = (OptlyResponseFile){0};
+
+  int fd = open(path, O_RDONLY);
+
+  struct stat st;
+
+  if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (uint64_t)st.st_size > OPTLY_RESPONSE_FILE_MAX_SIZE) {
+    OPTLY_LOG(ERROR, "Can't read response file '%s'", path);
+    optly__push_error(errs, OPTLY_ERR_RESPONSE_FILE, path);
+
+    if (fd >= 0) close(fd);
+    return;
+  }
+
+  size_t page   = (size_t)sysconf(_SC_PAGESIZE);
+  size_t length = (size_t)st.st_size;
+  size_t text   = (length + 1 + page - 1) / page * page;
+  size_t size   = text + (length / 2 + 2) * sizeof(char *);
+
+  unsigned char *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (addr == MAP_FAILED) {
+    OPTLY_LOG(ERROR, "Can't map response file '%s'", path);
+    optly__push_error(errs, OPTLY_ERR_RESPONSE_FILE, path);
+    close(fd);
+    return;
+  }
+
+  if (length > 0 && mmap(addr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+    OPTLY_LOG(ERROR, "Can't map response file '%s'", path);
+    optly__push_error(errs, OPTLY_ERR_RESPONSE_FILE, path);
+    munmap(addr, size);
+    close(fd);
+    return;
+  }
+
+  close(fd);
+
+  file->addr   = addr;
+  file->size   = size;
+  file->tokens = (char **)(addr + text);
+
+  char *unclosed = NULL;
+  file->count    = optly__tokenize((char *)addr, file->tokens, length / 2 + 2, NULL, &unclosed);
+
+  if (unclosed) {
+    OPTLY_LOG(ERROR, "Quote is not closed in '%s' of response file '%s'", unclosed, path);
+    optly__push_error(errs, OPTLY_ERR_UNCLOSED_QUOTE, path);
+  }
+}
+
+/**
+ * Walk args expanding @file. First run (out == NULL) maps files and counts
+ * resulting args, second one walks files in the same order and fills `out`.
+ */
+static size_t optly__expand(OptlyResponseFiles *files, char **args, size_t count, char **out, size_t *next, size_t depth, bool *literal, OptlyErrors *errs) {
+  size_t n = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    char *arg = args[i];
+
+    if (!*literal && strcmp(arg, "--") == 0) {
+      *literal = true;
+    }
+
+    if (*literal || arg[0] != '@' || arg[1] == '\0') {
+      if (out) out[n] = arg;
+      n++;
+      continue;
+    }
+
+    if (depth == OPTLY_RESPONSE_FILE_DEPTH) {
+      if (!out) {
+        OPTLY_LOG(ERROR, "Response files are nested deeper than %d, '%s' is not read", OPTLY_RESPONSE_FILE_DEPTH, arg + 1);
+        optly__push_error(errs, OPTLY_ERR_RESPONSE_FILE_DEPTH, arg + 1);
+      }
+
+      continue;
+    }
+
+    if (!out && files->count == OPTLY_RESPONSE_FILES_MAX) {
+      OPTLY_LOG(ERROR, "Too many response files, '%s' is not read", arg + 1);
+      optly__push_error(errs, OPTLY_ERR_RESPONSE_FILE, arg + 1);
+      continue;
+    }
+
+    if (out && *next == files->count) {
+      continue;
+    }
+
+    OptlyResponseFile *file = out ? &files->files[(*next)++] : &files->files[files->count++];
+
+    if (!out) {
+      optly__map_response_file(file, arg + 1, errs);
+    }
+
+    if (file->tokens) {
+      n += optly__expand(files, file->tokens, file->count, out ? out + n : NULL, next, depth + 1, literal, errs);
+    }
+  }
+
+  return n;
+}
+
+OPTLYDEF bool optly_expand_response_files(int *argc, char ***argv, OptlyResponseFiles *files, OptlyErrors *errs) {
+  size_t errors = errs ? errs->count : 0;
+  int    i      = 1;
+
+  for (; i < *argc && (*argv)[i]; i++) {
+    if ((*argv)[i][0] == '@' || strcmp((*argv)[i], "--") == 0) break;
+  }
+
+  if (i == *argc || !(*argv)[i] || (*argv)[i][0] != '@') {
+    return true;
+  }
+
+  size_t count = 0;
+  while (count < (size_t)*argc && (*argv)[count]) count++;
+
+  bool   literal = false;
+  size_t next    = 0;
+  size_t total   = optly__expand(files, *argv, count, NULL, &next, 0, &literal, errs);
+  size_t size    = (total + 1) * sizeof(char *);
+
+  char **out = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (out == MAP_FAILED) {
+    OPTLY_LOG(ERROR, "Not enough memory to expand response files");
+    optly__push_error(errs, OPTLY_ERR_OUT_OF_MEMORY, NULL);
+    return false;
+  }
+
+  literal = false;
+  optly__expand(files, *argv, count, out, &next, 0, &literal, errs);
+  out[total] = NULL;
+
+  files->argv      = out;
+  files->argv_size = size;
+
+  *argc = (int)total;
+  *argv = out;
+
+  return !errs || errs->count == errors;
+}
+
+OPTLYDEF void optly_response_files_free(OptlyResponseFiles *files) {
+  for (size_t i = 0; i < files->count; i++) {
+    if (files->files[i].addr) {
+      munmap(files->files[i].addr, files->files[i].size);
+    }
+  }
+
+  if (files->argv) {
+    munmap(files->argv, files->argv_size);
+  }
+
+  *files = (OptlyResponseFiles){0};
+}
+#endif
+
+/**
+ * Legacy API keeps results inside of schema itself.
+ */
+static void optly__write_back(OptlyResult *result) {
+  for (const OptlyResultCommand *level = result->commands; level; level = level->next) {
+    // NOTE: optly_parse_args always gets mutable schema, const is only there for the parser
+    OptlyCommand *cmd = (OptlyCommand *)level->command;
+
+    cmd->next_command = level->next ? (OptlyCommand *)level->next->command : NULL;
+
+    for (size_t w = 0, words = optly__mask_words(cmd); w < OPTLY_BOOL_WORDS; w++) {
+      cmd->bools[w] = w < words ? level->bools[w] : 0;
+    }
+
+    for (size_t i = 0; cmd->flags && !optly_is_flag_null(&cmd->flags[i]); i++) {
+      OptlyFlag *flag = &cmd->flags[i];
+
+      if (flag->type == OPTLY_TYPE_ENUM && !flag->list) {
+        flag->enum_index = optly_result_enum(level, i);
+      }
+
+      if (!optly__bit(level->present, i)) {
+        continue;
+      }
+
+      flag->present = true;
+
+      if (flag->list) {
+        // NOTE: Values went right into it
+      } else if (flag->type == OPTLY_TYPE_ENUM) {
+        flag->value.as_enum[0] = level->values[i].as_enum[0];
+      } else if (flag->type == OPTLY_TYPE_CPUSET) {
+        // NOTE: Parsed set lives in parse buffer, which is gone after return
+        if (flag->value.as_cpuset) *flag->value.as_cpuset = *level->values[i].as_cpuset;
+      } else if (flag->type == OPTLY_TYPE_CUSTOM) {
+        if (flag->value.as_custom) memcpy(flag->value.as_custom, level->values[i].as_custom, flag->converter->size);
       } else {
-        OPTLY_LOG(ERROR, "Unknown command %s", arg);
-        optly__push_error(&errs, OPTLY_ERR_UNKNOWN_COMMAND, arg);
+        flag->value = level->values[i];
       }
     }
 
-    SHIFT_ARG(argv, argc);
+    for (size_t i = 0; i < optly__positionals_count(cmd->positionals); i++) {
+      OptlyPositional   *def = &cmd->positionals[i];
+      const OptlyValues *pos = &level->positionals[i];
+
+      // NOTE: Typed values went right into `def->list`
+      def->values = pos->items;
+      def->count  = pos->count;
+    }
+  }
+}
+
+static unsigned char optly__args_buffer[OPTLY_PARSE_BUFFER_LENGTH];
+static void          *optly__args_blocks = NULL;
+
+/**
+ * Blocks are chained through their first pointer and kept for the rest of the
+ * program, so they are reachable and reused by later calls.
+ */
+static bool optly__args_grow(OptlyArena *arena, size_t need) {
+  size_t size = arena->size * 2;
+
+  if (size < OPTLY_PARSE_BUFFER_LENGTH) {
+    size = OPTLY_PARSE_BUFFER_LENGTH;
+  }
+
+  if (size < need) {
+    size = need;
+  }
+
+  void **block = malloc(sizeof(void *) + size);
+
+  if (!block) {
+    return false;
+  }
+
+  block[0]           = optly__args_blocks;
+  optly__args_blocks = block;
+
+  arena->base = (unsigned char *)(block + 1);
+  arena->size = size;
+  arena->used = 0;
+
+  return true;
+}
+
+static OptlyArena optly__args_arena = {optly__args_buffer, sizeof(optly__args_buffer), 0, optly__args_grow, NULL};
+
+#if defined(OPTLY_GEN_VERSION_FLAG) || defined(OPTLY_GEN_VERSION_COMMAND)
+OPTLYDEF OptlyErrors optly_parse_args(int argc, char *argv[], OptlyCommand *main_cmd, const char *version) {
+#else
+OPTLYDEF OptlyErrors optly_parse_args(int argc, char *argv[], OptlyCommand *main_cmd) {
+  const char *version = NULL;
+#endif
+  assert(argc > 0);
+
+  OptlyResult result = {.arena = optly__args_arena};
+
+  if (main_cmd->name == NULL) {
+    main_cmd->name = argv[0];
+  }
+
+#ifdef OPTLY_RESPONSE_FILES
+  // NOTE: Parsed values point into mapped files, so they are never unmapped
+  OptlyResponseFiles files = {0};
+  optly_expand_response_files(&argc, &argv, &files, &result.errors);
+#endif
+
+  OptlyParser p;
+
+#ifdef OPTLY_ARGV_POSITIONALS
+  // NOTE: Positional values are moved to the front of argv, so they need no
+  //       memory. Everything else is copied back, next call starts over in the
+  //       largest block so far
+  optly__init(&p, main_cmd, &result, main_cmd->name, version, argv + 1);
+  p.in_schema = true;
+  optly__parse(&p, argc, argv);
+  optly__write_back(&result);
+
+  optly__args_arena      = result.arena;
+  optly__args_arena.used = 0;
+#else
+  // NOTE: Positional values stay in this memory, next call goes after them
+  result.arena.base += optly__args_arena.used;
+  result.arena.size -= optly__args_arena.used;
+
+  optly__init(&p, main_cmd, &result, main_cmd->name, version, NULL);
+  p.in_schema = true;
+  optly__parse(&p, argc, argv);
+  optly__write_back(&result);
+
+  if (result.arena.base == optly__args_arena.base + optly__args_arena.used) {
+    optly__args_arena.used += result.arena.used;
+  } else {
+    optly__args_arena = result.arena;
   }
+#endif
 
-  for (OptlyCommand *cmd = main_cmd; cmd; cmd = cmd->next_command) {
-    optly__validate_flags(cmd, &errs);
-    optly__validate_positionals(cmd, &errs);
+  if (result.help) {
+    optly__usage(result.help, result.help->name, stderr);
+    exit(0);
   }
 
-  current_cmd->next_command = NULL;
+#if defined(OPTLY_GEN_VERSION_FLAG) || defined(OPTLY_GEN_VERSION_COMMAND)
+  if (result.version) {
+    fprintf(stderr, "%s: %s\n", main_cmd->name, version);
+    exit(0);
+  }
+#endif
 
 #ifndef OPTLY_NO_EXIT
-  if (errs.count > 0) {
+  for (size_t i = 0; i < result.errors.count; i++) {
+    // NOTE: Broken schema keeps its own exit code, as it always did
+    if (result.errors.items[i].kind == OPTLY_ERR_DUPLICATE_VARIADIC) {
+      exit(OPTLY_ERR_DUPLICATE_VARIADIC);
+    }
+  }
+
+  // NOTE: Only 'help <unknown>' stops with errors, it keeps its exit code too
+  if (p.stopped && result.errors.count > 0) {
+    exit(OPTLY_ERR_UNKNOWN_COMMAND);
+  }
+
+  if (result.errors.count > 0) {
     exit(EXIT_FAILURE);
   }
 #endif
 
-  return errs;
+  return result.errors;
 }
 
 #endif  // OPTLY_IMPLEMENTATION
 
-// TODO: Types for variadics?
-// TODO: Support different kind of numbers (0xBABA, 0123)?
-
 /*
    ------------------------------------------------------------------------------
    This software is available under 2 licenses -- choose whichever you prefer.
@@ -0,0 +1,469 @@
+/*
+  optly.hpp — C++20 front-end for optly.h
+
+  Schema is a type, so flag names are resolved while compiling: `get<"threads">()`
+  is a load at fixed position with the type of the flag, and a typo doesn't compile.
+  Flag arrays, name tables and short name table are constexpr, nothing is built at
+  startup. Parsing itself is done by C core with `optly_parse`.
+
+    #include "optly.hpp"
+
+    using app = optly::command<"app", "Demo app",
+      optly::flags<
+        optly::flag<"verbose", OPTLY_TYPE_BOOL, 'v', "Enable verbose output">,
+        optly::flag<"threads", OPTLY_TYPE_UINT32, 't', "Worker threads", 4>
+      >,
+      optly::commands<
+        optly::command<"run", "Runs server",
+          optly::flags<optly::flag<"port", OPTLY_TYPE_UINT16, 'p', "Server port", 8080>>,
+          optly::commands<>,
+          optly::positionals<optly::positional<"address", "Address to listen on", 0, 1>>
+        >
+      >
+    >;
+
+    int main(int argc, char **argv) {
+      static char          buf[1 << 16];
+      optly::result<app> res(buf, sizeof(buf));
+
+      if (!res.parse(argc, argv)) return 1;
+
+      uint32_t threads = res.get<"threads">();
+
+      if (auto run = res.command<"run">()) {
+        uint16_t port = run.get<"port">();
+      }
+    }
+
+  Implementation stays in C: define OPTLY_IMPLEMENTATION and include optly.h in
+  one .c file of your project, same defines (OPTLY_GEN_HELP_FLAG and such) for both.
+
+  Flags of scalar types, strings, sizes, durations and rates are supported. Enum,
+  CPU set, custom and list flags need runtime data and are left to C API.
+*/
+
+#ifndef OPTLY_HPP
+#define OPTLY_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+#include "optly.h"
+
+namespace optly {
+
+// String usable as template argument: command<"app", ...>, get<"threads">()
+template <std::size_t N>
+struct name {
+  char value[N]{};
+
+  consteval name(const char (&str)[N]) {
+    for (std::size_t i = 0; i < N; i++) {
+      value[i] = str[i];
+    }
+  }
+
+  constexpr std::string_view view() const {
+    return {value, N - 1};
+  }
+};
+
+inline constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+namespace detail {
+
+// C++ type and union member of every supported flag type
+template <OptlyFlagType Type>
+struct traits {
+  static_assert(Type != Type, "Flag type is not supported by optly.hpp, use C API for it");
+};
+
+#define OPTLY_HPP_TRAITS(type_, cpp_type, member)                           \
+  template <>                                                               \
+  struct traits<type_> {                                                    \
+    using type = cpp_type;                                                  \
+    static constexpr OptlyFlagValue make(type v) {                          \
+      return OptlyFlagValue{.member = v};                                   \
+    }                                                                       \
+    static type get(const OptlyFlagValue &v) {                              \
+      return v.member;                                                      \
+    }                                                                       \
+  };
+
+OPTLY_HPP_TRAITS(OPTLY_TYPE_BOOL, bool, as_bool)
+OPTLY_HPP_TRAITS(OPTLY_TYPE_CHAR, char, as_char)
+OPTLY_HPP_TRAITS(OPTLY_TYPE_INT8, int8_t, as_int8)
+OPTLY_HPP_TRAITS(OPTLY_TYPE_INT16, int16_t, as_int16)
+OPTLY_HPP_TRAITS(OPTLY_TYPE_INT32, int32_t, as_int32)
+OPTLY_HPP_TRAITS(OPTLY_TYPE_INT64, int64_t, as_int64)
+OPTLY_HPP_TRAITS(OPTLY_TYPE_UINT8, uint8_t, as_uint8)
+OPTLY_HPP_TRAITS(OPTLY_TYPE_UINT16, uint16_t, as_uint16)
+OPTLY_HPP_TRAITS(OPTLY_TYPE_UINT32, uint32_t, as_uint32)
+OPTLY_HPP_TRAITS(OPTLY_TYPE_UINT64, uint64_t, as_uint64)
+OPTLY_HPP_TRAITS(OPTLY_TYPE_FLOAT, float, as_float)
+OPTLY_HPP_TRAITS(OPTLY_TYPE_DOUBLE, double, as_double)
+OPTLY_HPP_TRAITS(OPTLY_TYPE_SIZE, uint64_t, as_uint64)
+OPTLY_HPP_TRAITS(OPTLY_TYPE_DURATION, int64_t, as_int64)
+OPTLY_HPP_TRAITS(OPTLY_TYPE_RATE, double, as_double)
+
+#undef OPTLY_HPP_TRAITS
+
+// NOTE: C core takes `char *` but never writes through schema pointers in `optly_parse`
+constexpr char *mut(const char *str) {
+  return const_cast<char *>(str);
+}
+
+template <>
+struct traits<OPTLY_TYPE_STRING> {
+  using type = const char *;
+  static constexpr OptlyFlagValue make(type v) {
+    return OptlyFlagValue{.as_string = mut(v)};
+  }
+  static type get(const OptlyFlagValue &v) {
+    return v.as_string;
+  }
+};
+
+constexpr char *text(std::string_view str) {
+  return str.empty() ? nullptr : mut(str.data());
+}
+
+// FNV-1a, only C++ side hashes names for its tables
+constexpr uint32_t hash(std::string_view str) {
+  uint32_t h = 2166136261u;
+
+  for (char c : str) {
+    h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+  }
+
+  return h;
+}
+
+// Same load factor as `optly_compile` tables
+constexpr std::size_t table_size(std::size_t count) {
+  std::size_t size = 8;
+
+  while (size < count * 2) {
+    size <<= 1;
+  }
+
+  return size;
+}
+
+struct slot {
+  uint32_t hash;
+  uint32_t len;
+  uint32_t index;  // Position + 1, 0 marks an empty slot
+};
+
+// Open-addressed table of names built while compiling. First definition wins on duplicates.
+template <std::size_t Count>
+struct table {
+  static constexpr std::size_t size = table_size(Count);
+  static constexpr std::size_t mask = size - 1;
+
+  std::array<slot, size> slots{};
+
+  consteval explicit table(const std::array<std::string_view, Count> &names) {
+    for (std::size_t i = 0; i < Count; i++) {
+      if (names[i].empty() || find(names[i])) continue;
+
+      uint32_t    h = hash(names[i]);
+      std::size_t s = h & mask;
+
+      while (slots[s].index) {
+        s = (s + 1) & mask;
+      }
+
+      slots[s] = {h, static_cast<uint32_t>(names[i].size()), static_cast<uint32_t>(i + 1)};
+    }
+  }
+
+  constexpr const slot *find(std::string_view name) const {
+    uint32_t h = hash(name);
+
+    for (std::size_t s = h & mask; slots[s].index; s = (s + 1) & mask) {
+      if (slots[s].hash == h && slots[s].len == name.size()) {
+        return &slots[s];
+      }
+    }
+
+    return nullptr;
+  }
+};
+
+template <std::size_t Count>
+consteval std::size_t position(const std::array<std::string_view, Count> &names, std::string_view name) {
+  for (std::size_t i = 0; i < Count; i++) {
+    if (names[i] == name) return i;
+  }
+
+  return npos;
+}
+
+}  // namespace detail
+
+template <name Name, OptlyFlagType Type, char Short = 0, name Description = "", auto Default = 0, bool Required = false>
+struct flag {
+  using type = typename detail::traits<Type>::type;
+
+  static constexpr std::string_view long_name  = Name.view();
+  static constexpr OptlyFlagType    flag_type  = Type;
+  static constexpr char             short_name = Short;
+
+  static consteval OptlyFlagValue value() {
+    if constexpr (Type == OPTLY_TYPE_STRING) {
+      if constexpr (std::is_integral_v<decltype(Default)>) {
+        static_assert(Default == 0, "Default of string flag is a string");
+        return OptlyFlagValue{.as_string = nullptr};
+      } else {
+        return OptlyFlagValue{.as_string = detail::mut(Default.value)};
+      }
+    } else {
+      return detail::traits<Type>::make(static_cast<type>(Default));
+    }
+  }
+
+  static consteval OptlyFlag make() {
+    OptlyFlag f{};
+    f.fullname    = detail::mut(Name.value);
+    f.shortname   = Short;
+    f.description = detail::text(Description.view());
+    f.required    = Required;
+    f.value       = value();
+    f.type        = Type;
+    f.enum_index  = OPTLY_ENUM_NONE;
+    return f;
+  }
+};
+
+// Max = 0 takes any number of values
+template <name Name, name Description = "", std::size_t Min = 0, std::size_t Max = 1>
+struct positional {
+  static constexpr std::string_view pos_name = Name.view();
+
+  static consteval OptlyPositional make() {
+    OptlyPositional p{};
+    p.name        = detail::mut(Name.value);
+    p.description = detail::text(Description.view());
+    p.min         = Min;
+    p.max         = Max;
+    return p;
+  }
+};
+
+template <typename... Flags>
+struct flags {};
+
+template <typename... Commands>
+struct commands {};
+
+template <typename... Positionals>
+struct positionals {};
+
+template <name Name, name Description = "", typename Flags = flags<>, typename Commands = commands<>, typename Positionals = positionals<>>
+struct command;
+
+template <name Name, name Description, typename... F, typename... C, typename... P>
+struct command<Name, Description, flags<F...>, commands<C...>, positionals<P...>> {
+  static constexpr std::string_view cmd_name = Name.view();
+
+  static constexpr std::array<std::string_view, sizeof...(F)> flag_names    = {F::long_name...};
+  static constexpr std::array<std::string_view, sizeof...(C)> command_names = {C::cmd_name...};
+  static constexpr std::array<std::string_view, sizeof...(P)> pos_names     = {P::pos_name...};
+
+  static constexpr std::array<OptlyFlag, sizeof...(F) + 1>       c_flags       = {F::make()..., OptlyFlag{}};
+  static constexpr std::array<OptlyCommand, sizeof...(C) + 1>    c_commands    = {C::make()..., OptlyCommand{}};
+  static constexpr std::array<OptlyPositional, sizeof...(P) + 1> c_positionals = {P::make()..., OptlyPositional{}};
+
+  static constexpr detail::table<sizeof...(F)> long_table{flag_names};
+  static constexpr detail::table<sizeof...(C)> command_table{command_names};
+
+  // Required flags, same layout as first mask of `optly_compile`
+  static constexpr std::array<uint64_t, (sizeof...(F) + 63) / 64> c_masks = [] {
+    std::array<uint64_t, (sizeof...(F) + 63) / 64> masks{};
+
+    for (std::size_t i = 0; i < sizeof...(F); i++) {
+      if (c_flags[i].required) masks[i / 64] |= OPTLY_BIT(i);
+    }
+
+    return masks;
+  }();
+
+  static uint32_t match_long(const char *name, std::size_t len) {
+    const detail::slot *s = long_table.find({name, len});
+    return s && std::memcmp(c_flags[s->index - 1].fullname, name, len) == 0 ? s->index : 0;
+  }
+
+  static uint32_t match_command(const char *name, std::size_t len) {
+    const detail::slot *s = command_table.find({name, len});
+    return s && std::memcmp(c_commands[s->index - 1].name, name, len) == 0 ? s->index : 0;
+  }
+
+  static constexpr OptlyIndex c_index = [] {
+    OptlyIndex index{};
+
+    for (std::size_t i = sizeof...(F); i-- > 0;) {
+      if (c_flags[i].shortname) {
+        index.shorts[static_cast<unsigned char>(c_flags[i].shortname)] = static_cast<uint16_t>(i + 1);
+      }
+    }
+
+    index.masks         = sizeof...(F) ? const_cast<uint64_t *>(c_masks.data()) : nullptr;
+    index.match_long    = match_long;
+    index.match_command = match_command;
+    return index;
+  }();
+
+  static consteval OptlyCommand make() {
+    OptlyCommand c{};
+    c.name        = detail::mut(Name.value);
+    c.description = detail::text(Description.view());
+    c.flags       = sizeof...(F) ? const_cast<OptlyFlag *>(c_flags.data()) : nullptr;
+    c.commands    = sizeof...(C) ? const_cast<OptlyCommand *>(c_commands.data()) : nullptr;
+    c.positionals = sizeof...(P) ? const_cast<OptlyPositional *>(c_positionals.data()) : nullptr;
+    c.index       = const_cast<OptlyIndex *>(&c_index);
+    return c;
+  }
+
+  static constexpr OptlyCommand c_command = make();
+
+  template <name Flag>
+  static constexpr std::size_t flag_position = detail::position(flag_names, Flag.view());
+
+  template <name Sub>
+  static constexpr std::size_t command_position = detail::position(command_names, Sub.view());
+
+  template <name Pos>
+  static constexpr std::size_t positional_position = detail::position(pos_names, Pos.view());
+
+  template <std::size_t I>
+  using flag_at = std::tuple_element_t<I, std::tuple<F...>>;
+
+  template <std::size_t I>
+  using command_at = std::tuple_element_t<I, std::tuple<C...>>;
+};
+
+// One command of parse result. Empty (false) if command wasn't selected.
+template <typename Command>
+class view {
+ public:
+  explicit view(const OptlyResultCommand *level) : level_(level) {}
+
+  explicit operator bool() const {
+    return level_ != nullptr;
+  }
+
+  // Value of flag, its default if flag wasn't given. Pass T to check that flag has that type.
+  template <name Flag, typename T = void>
+  auto get() const {
+    constexpr std::size_t i = Command::template flag_position<Flag>;
+    static_assert(i != npos, "Command has no such flag");
+
+    using F = typename Command::template flag_at<i>;
+    static_assert(std::is_void_v<T> || std::is_same_v<T, typename F::type>, "Flag has different type");
+
+    if constexpr (F::flag_type == OPTLY_TYPE_BOOL) {
+      return optly_result_bool(level_, i);
+    } else {
+      return detail::traits<F::flag_type>::get(level_->values[i]);
+    }
+  }
+
+  template <name Flag>
+  bool has() const {
+    constexpr std::size_t i = Command::template flag_position<Flag>;
+    static_assert(i != npos, "Command has no such flag");
+
+    return optly_result_flag_present(level_, i);
+  }
+
+  template <name Pos>
+  const OptlyValues &positional() const {
+    constexpr std::size_t i = Command::template positional_position<Pos>;
+    static_assert(i != npos, "Command has no such positional");
+
+    return level_->positionals[i];
+  }
+
+  template <name Sub>
+  auto command() const {
+    constexpr std::size_t i = Command::template command_position<Sub>;
+    static_assert(i != npos, "Command has no such subcommand");
+
+    using S = typename Command::template command_at<i>;
+
+    const OptlyResultCommand *next = level_->next;
+    return view<S>(next && next->command == &Command::c_commands[i] ? next : nullptr);
+  }
+
+  const OptlyResultCommand *c() const {
+    return level_;
+  }
+
+ private:
+  const OptlyResultCommand *level_;
+};
+
+// Parse result backed by your buffer, see `optly_parse`
+template <typename Command>
+class result {
+ public:
+  result(void *buf, std::size_t size) {
+    res_.arena = OptlyArena{static_cast<unsigned char *>(buf), size, 0, nullptr, nullptr};
+  }
+
+#if defined(OPTLY_GEN_VERSION_FLAG) || defined(OPTLY_GEN_VERSION_COMMAND)
+  bool parse(int argc, char **argv, const char *version) {
+    return optly_parse(&Command::c_command, argc, argv, &res_, version);
+  }
+#else
+  bool parse(int argc, char **argv) {
+    return optly_parse(&Command::c_command, argc, argv, &res_);
+  }
+#endif
+
+  const OptlyErrors &errors() const {
+    return res_.errors;
+  }
+
+  view<Command> root() const {
+    return view<Command>(res_.commands);
+  }
+
+  template <name Flag, typename T = void>
+  auto get() const {
+    return root().template get<Flag, T>();
+  }
+
+  template <name Flag>
+  bool has() const {
+    return root().template has<Flag>();
+  }
+
+  template <name Pos>
+  const OptlyValues &positional() const {
+    return root().template positional<Pos>();
+  }
+
+  template <name Sub>
+  auto command() const {
+    return root().template command<Sub>();
+  }
+
+  OptlyResult *c() {
+    return &res_;
+  }
+
+ private:
+  OptlyResult res_{};
+};
+
+}  // namespace optly
+
+#endif  // OPTLY_HPP
@@ -1,10 +1,18 @@
+#define _DEFAULT_SOURCE  // mkstemp, MAP_ANONYMOUS for response files
+
+#include <locale.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #define OPTLY_NO_EXIT
+#define OPTLY_RESPONSE_FILES
+#define OPTLY_GENERATOR
+#define OPTLY_THREADS
 #define OPTLY_IMPLEMENTATION
 #define OPTLY_LOG(...)
 #include "optly.h"
@@ -137,6 +145,211 @@ static void test_long_short_and_batch_bools(void) {
   ASSERT_TRUE(optly_flag_value_bool(&cmd, "c"));
 }
 
+static void test_token_forms(void) {
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_string("define", .shortname = 'D'),
+      optly_flag_bool("all", .shortname = 'a'),
+      optly_flag_bool("brief", .shortname = 'b')
+    ),
+    .positionals = optly_positionals(optly_positional("rest", .min = 0, .max = 0))
+  );
+
+  char       *argv[] = ARGV("app", "--define=KEY=1", "-ab", "-D=x=y", "--", "-", "--all");
+  OptlyErrors errs   = optly_parse_args(count_argc(argv), argv, &cmd);
+
+  assert_err_count(&errs, 0);
+  // Only first '=' separates value
+  ASSERT_EQ_STR(optly_flag_value_string(&cmd, "define"), "x=y");
+  ASSERT_TRUE(optly_flag_value_bool(&cmd, "all") && optly_flag_value_bool(&cmd, "brief"));
+
+  OptlyPositional *rest = optly_get_positional(&cmd, "rest");
+  ASSERT_EQ_INT(rest->count, 2);
+  ASSERT_EQ_STR(rest->values[0], "-");
+  ASSERT_EQ_STR(rest->values[1], "--all");
+
+  char *lone[] = ARGV("app", "-");
+
+  errs = optly_parse_args(count_argc(lone), lone, &cmd);
+  assert_err_count(&errs, 1);
+  assert_err_at(&errs, 0, OPTLY_ERR_UNKNOWN_FLAG, "-");
+}
+
+static void test_long_names_without_copy(void) {
+  static char long_name[300 + 1];
+  static char token[2 + 300 + 3 + 1];
+  static char cut[2 + 255 + 3 + 1];
+  char       *truncated = cut;
+
+  memset(long_name, 'x', 300);
+  snprintf(token, sizeof(token), "--%s=42", long_name);
+  snprintf(cut, sizeof(cut), "--%.255s=42", long_name);
+
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_uint32(long_name, .description = "long"),
+      optly_flag_uint32("verbose", .description = "verbose")
+    )
+  );
+
+  for (int compiled = 0; compiled < 2; compiled++) {
+    char       buf[4096];
+    OptlyArena arena = optly_arena(buf, sizeof(buf));
+
+    if (compiled) {
+      ASSERT_TRUE(optly_compile(&cmd, &arena));
+    }
+
+    char       *argv[] = ARGV("app", token, "--verbose=1");
+    OptlyErrors errs   = optly_parse_args(count_argc(argv), argv, &cmd);
+    assert_err_count(&errs, 0);
+    ASSERT_EQ_INT(optly_flag_value_uint32(&cmd, long_name), 42);
+
+    // Prefix of a name or name cut at 255 bytes is not that flag
+    char *bad[] = ARGV("app", "--verb=1", truncated, "--verbosely=1");
+
+    errs = optly_parse_args(count_argc(bad), bad, &cmd);
+    assert_err_count(&errs, 3);
+    assert_err_at(&errs, 0, OPTLY_ERR_UNKNOWN_FLAG, "--verb=1");
+    assert_err_at(&errs, 1, OPTLY_ERR_UNKNOWN_FLAG, truncated);
+    assert_err_at(&errs, 2, OPTLY_ERR_UNKNOWN_FLAG, "--verbosely=1");
+  }
+}
+
+static void test_usage_to_buffer(void) {
+  OptlyCommand cmd = optly_command(
+    "app", "Demo app",
+    .flags = optly_flags(
+      optly_flag_bool("verbose", 'v', "Verbose"),
+      optly_flag_uint32("threads", 't', "Threads", .value.as_uint32 = 4)
+    ),
+    .commands    = optly_commands(optly_command("run", "Run it")),
+    .positionals = optly_positionals(optly_positional("file", "Input", .min = 1, .max = 1))
+  );
+
+  const char *expected =
+    "Demo app\n\n"
+    "Usage: app [FLAGS] <file> <COMMAND>\n"
+    "\nCOMMANDS\n"
+    "  run  Run it\n"
+    "\nPOSITIONAL ARGUMENTS\n"
+    "  file  (1..1 values)\n"
+    "\nFLAGS\n"
+    "  -v --verbose          Verbose\n"
+    "  -t --threads <u32>    Threads (default: 4)\n";
+
+  char   buf[1024];
+  size_t len = optly_usage_to_buffer(&cmd, buf, sizeof(buf));
+  ASSERT_EQ_INT(len, strlen(expected));
+  ASSERT_EQ_STR(buf, expected);
+
+  // Too small buffer is truncated like snprintf and still tells full length
+  char small[16];
+  ASSERT_EQ_INT(optly_usage_to_buffer(&cmd, small, sizeof(small)), len);
+  ASSERT_TRUE(strncmp(small, expected, sizeof(small) - 1) == 0);
+  ASSERT_EQ_INT(small[sizeof(small) - 1], '\0');
+  ASSERT_EQ_INT(optly_usage_to_buffer(&cmd, NULL, 0), len);
+
+  // File variant writes the same bytes
+  FILE *file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  if (!file) return;
+
+  optly_usage_to_file(&cmd, file);
+  rewind(file);
+
+  char   written[1024] = {0};
+  size_t n             = fread(written, 1, sizeof(written) - 1, file);
+  fclose(file);
+
+  ASSERT_EQ_INT(n, len);
+  ASSERT_EQ_STR(written, expected);
+
+  // Column widens only for command that has longer type name
+  OptlyCommand timed = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_bool("verbose", 'v', "Verbose"),
+      optly_flag_duration("timeout", 't', "Timeout")
+    )
+  );
+
+  const char *widened =
+    "Usage: app [FLAGS]\n"
+    "\nFLAGS\n"
+    "  -v --verbose            Verbose\n"
+    "  -t --timeout <duration>  Timeout\n";
+
+  ASSERT_EQ_INT(optly_usage_to_buffer(&timed, buf, sizeof(buf)), strlen(widened));
+  ASSERT_EQ_STR(buf, widened);
+}
+
+static void test_packed_bools(void) {
+  enum { OPT_VERBOSE = 0, OPT_THREADS = 1, OPT_COLOR = 2, OPT_DRY_RUN = 3 };
+
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_bool("verbose", 'v', "Verbose"),
+      optly_flag_uint32("threads", .shortname = 't'),
+      optly_flag_bool("color", .shortname = 'c', .value.as_bool = true),
+      optly_flag_bool("dry-run", .shortname = 'n')
+    )
+  );
+
+  char        mem[2048];
+  OptlyResult res    = optly_result(mem, sizeof(mem));
+  char       *argv[] = ARGV("app", "-vn", "-t", "4");
+
+  ASSERT_TRUE(optly_parse(&cmd, count_argc(argv), argv, &res));
+
+  uint64_t bits = res.commands->bools[0];
+  ASSERT_TRUE(bits == (OPTLY_BIT(OPT_VERBOSE) | OPTLY_BIT(OPT_COLOR) | OPTLY_BIT(OPT_DRY_RUN)));
+  ASSERT_TRUE(optly_result_bool(res.commands, OPT_COLOR));
+  ASSERT_FALSE(optly_result_bool(res.commands, OPT_THREADS));
+  // Default is not presence
+  ASSERT_FALSE(optly_result_flag_present(res.commands, OPT_COLOR));
+
+  char *legacy[] = ARGV("app", "--dry-run");
+
+  OptlyErrors errs = optly_parse_args(count_argc(legacy), legacy, &cmd);
+  assert_err_count(&errs, 0);
+  ASSERT_TRUE((cmd.bools[OPTLY_WORD(OPT_DRY_RUN)] & OPTLY_BIT(OPT_DRY_RUN)) && (cmd.bools[0] & OPTLY_BIT(OPT_COLOR)));
+  ASSERT_FALSE(cmd.bools[0] & OPTLY_BIT(OPT_VERBOSE));
+
+  // Bool past first word is in result words only, not mixed into cmd.bools
+  static OptlyFlag wide[72];
+  static char      names[70][16];
+
+  for (int i = 0; i < 70; i++) {
+    snprintf(names[i], sizeof(names[i]), "f%d", i);
+    wide[i] = optly_flag_bool(names[i], 0, "Flag");
+  }
+
+  wide[70]                  = (OptlyFlag)NULL_FLAG;
+  OptlyCommand wide_cmd     = optly_command("app", .flags = wide);
+  char        *wide_argv[]  = ARGV("app", "--f65");
+
+  errs = optly_parse_args(count_argc(wide_argv), wide_argv, &wide_cmd);
+  assert_err_count(&errs, 0);
+  ASSERT_TRUE(wide_cmd.bools[0] == 0);
+  ASSERT_TRUE(optly_flag_value_bool(&wide_cmd, "f65"));
+
+  res = optly_result(mem, sizeof(mem));
+  ASSERT_TRUE(optly_parse(&wide_cmd, count_argc(wide_argv), wide_argv, &res));
+  ASSERT_TRUE(res.commands->bools[OPTLY_WORD(65)] == OPTLY_BIT(65));
+
+  // Generated constants of such flag would be read from cmd.bools, so generator refuses it
+  FILE *file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  if (!file) return;
+
+  ASSERT_FALSE(optly_generate(&wide_cmd, "app", file));
+  fclose(file);
+}
+
 static void test_inline_and_separate_values(void) {
   OptlyCommand cmd = optly_command(
     "app",
@@ -204,6 +417,383 @@ static void test_typed_values(void) {
   ASSERT_FLOAT_NEAR(optly_flag_value_double(&cmd, "f64"), 2.5, 1e-9);
 }
 
+static void test_number_formats_and_ranges(void) {
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_int8("i8", .description = "i8"),
+      optly_flag_int64("i64", .description = "i64"),
+      optly_flag_uint8("u8", .value.as_uint8 = 7),
+      optly_flag_uint16("u16", .description = "u16"),
+      optly_flag_uint32("u32", .description = "u32"),
+      optly_flag_uint64("u64", .description = "u64"),
+      optly_flag_float("f32", .description = "f32"),
+      optly_flag_double("f64", .description = "f64")
+    )
+  );
+
+  char *argv[] = ARGV("app", "--i8=-128", "--i64=-9223372036854775808", "--u16=0xFF_FF", "--u32=1_000_000", "--u64=18446744073709551615", "--f32=0.1", "--f64=1_000.25e-2");
+
+  OptlyErrors errs = optly_parse_args(count_argc(argv), argv, &cmd);
+  assert_err_count(&errs, 0);
+  ASSERT_EQ_INT(optly_flag_value_int8(&cmd, "i8"), -128);
+  ASSERT_TRUE(optly_flag_value_int64(&cmd, "i64") == INT64_MIN);
+  ASSERT_EQ_INT(optly_flag_value_uint16(&cmd, "u16"), 0xFFFF);
+  ASSERT_EQ_INT(optly_flag_value_uint32(&cmd, "u32"), 1000000);
+  ASSERT_TRUE(optly_flag_value_uint64(&cmd, "u64") == UINT64_MAX);
+  // Correctly rounded, not just near
+  ASSERT_TRUE(optly_flag_value_float(&cmd, "f32") == 0.1f);
+  ASSERT_TRUE(optly_flag_value_double(&cmd, "f64") == 10.0025);
+
+  char *radix[] = ARGV("app", "--u8=0b1010_1010", "--u16=0o17", "--u32=017", "--f64=0.3000000000000000444089209850062616169452667236328125");
+
+  errs = optly_parse_args(count_argc(radix), radix, &cmd);
+  assert_err_count(&errs, 0);
+  ASSERT_EQ_INT(optly_flag_value_uint8(&cmd, "u8"), 0xAA);
+  ASSERT_EQ_INT(optly_flag_value_uint16(&cmd, "u16"), 15);
+  ASSERT_EQ_INT(optly_flag_value_uint32(&cmd, "u32"), 15);
+  ASSERT_TRUE(optly_flag_value_double(&cmd, "f64") == 0.30000000000000004);
+
+  OptlyCommand fresh = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_int8("i8", .description = "i8"),
+      optly_flag_uint8("u8", .value.as_uint8 = 7),
+      optly_flag_uint64("u64", .description = "u64"),
+      optly_flag_float("f32", .description = "f32"),
+      optly_flag_double("f64", .description = "f64"),
+      optly_flag_uint32("u32", .description = "u32")
+    )
+  );
+
+  char *bad[] = ARGV("app", "--u8=300", "--i8=128", "--u64=18446744073709551616", "--u32=-1", "--f32=1e39", "--f64=1__0", "--u32=1_");
+
+  errs = optly_parse_args(count_argc(bad), bad, &fresh);
+  assert_err_count(&errs, 7);
+  assert_err_at(&errs, 0, OPTLY_ERR_INVALID_VALUE, "300");
+  assert_err_at(&errs, 1, OPTLY_ERR_INVALID_VALUE, "128");
+  assert_err_at(&errs, 2, OPTLY_ERR_INVALID_VALUE, "18446744073709551616");
+  assert_err_at(&errs, 3, OPTLY_ERR_INVALID_VALUE, "-1");
+  assert_err_at(&errs, 4, OPTLY_ERR_INVALID_VALUE, "1e39");
+  assert_err_at(&errs, 5, OPTLY_ERR_INVALID_VALUE, "1__0");
+  assert_err_at(&errs, 6, OPTLY_ERR_INVALID_VALUE, "1_");
+  // Invalid value doesn't overwrite default
+  ASSERT_EQ_INT(optly_flag_value_uint8(&fresh, "u8"), 7);
+
+  // Locale with decimal comma changes nothing, not even for numbers past fast path
+  const char *locales[] = {"de_DE.UTF-8", "de_DE.utf8", "ru_RU.UTF-8", "fr_FR.UTF-8", "xx_XX"};
+  const char *comma     = NULL;
+
+  for (size_t i = 0; i < sizeof(locales) / sizeof(locales[0]) && !comma; i++) {
+    comma = setlocale(LC_NUMERIC, locales[i]);
+  }
+
+  if (!comma || strcmp(localeconv()->decimal_point, ",") != 0) {
+    setlocale(LC_NUMERIC, "C");
+    return;
+  }
+
+  char *local[] = ARGV("app", "--f64=1,5", "--f32=0,12345678901234567890123", "--f64=0.12345678901234567890123");
+
+  errs = optly_parse_args(count_argc(local), local, &fresh);
+  setlocale(LC_NUMERIC, "C");
+  assert_err_count(&errs, 2);
+  assert_err_at(&errs, 0, OPTLY_ERR_INVALID_VALUE, "1,5");
+  assert_err_at(&errs, 1, OPTLY_ERR_INVALID_VALUE, "0,12345678901234567890123");
+  ASSERT_TRUE(optly_flag_value_double(&fresh, "f64") == 0.12345678901234567890123);
+}
+
+static void test_unit_types(void) {
+  OptlyCpuSet cpus    = {0};
+  int64_t     timeout = 0;
+
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_size("cache", .value.as_uint64 = 4ull << 30),
+      optly_flag_size("page", .description = "page"),
+      optly_flag_duration("timeout", .bind.as_int64 = &timeout),
+      optly_flag_duration("grace", .description = "grace"),
+      optly_flag_rate("rate", .description = "rate"),
+      optly_flag_rate("burst", .description = "burst"),
+      optly_flag_cpuset("cpus", .value.as_cpuset = &cpus)
+    )
+  );
+
+  char *argv[] = ARGV("app", "--cache=1.5GB", "--page=4KiB", "--timeout=1h30m", "--grace=-250ms", "--rate=10k/s", "--burst=5/ms", "--cpus=0-7,16-23,1023");
+
+  OptlyErrors errs = optly_parse_args(count_argc(argv), argv, &cmd);
+  assert_err_count(&errs, 0);
+  ASSERT_TRUE(optly_flag_value_size(&cmd, "cache") == 1500000000ull);
+  ASSERT_TRUE(optly_flag_value_size(&cmd, "page") == 4096);
+  ASSERT_TRUE(timeout == 5400ll * 1000000000);
+  ASSERT_TRUE(optly_flag_value_duration(&cmd, "grace") == -250000000);
+  ASSERT_FLOAT_NEAR(optly_flag_value_rate(&cmd, "rate"), 10000.0, 1e-9);
+  ASSERT_FLOAT_NEAR(optly_flag_value_rate(&cmd, "burst"), 5000.0, 1e-9);
+  ASSERT_TRUE(optly_flag_value_cpuset(&cmd, "cpus") == &cpus);
+  ASSERT_TRUE(optly_cpuset_has(&cpus, 0) && optly_cpuset_has(&cpus, 7) && optly_cpuset_has(&cpus, 16));
+  ASSERT_TRUE(!optly_cpuset_has(&cpus, 8) && !optly_cpuset_has(&cpus, 24) && optly_cpuset_has(&cpus, 1023));
+
+  char *more[] = ARGV("app", "--cache=2k", "--page=3", "--timeout=0", "--grace=1.5s", "--rate=1.5M/min");
+
+  errs = optly_parse_args(count_argc(more), more, &cmd);
+  assert_err_count(&errs, 0);
+  ASSERT_TRUE(optly_flag_value_size(&cmd, "cache") == 2048);
+  ASSERT_TRUE(optly_flag_value_size(&cmd, "page") == 3);
+  ASSERT_TRUE(timeout == 0);
+  ASSERT_TRUE(optly_flag_value_duration(&cmd, "grace") == 1500000000);
+  ASSERT_FLOAT_NEAR(optly_flag_value_rate(&cmd, "rate"), 25000.0, 1e-9);
+
+  OptlyCommand fresh = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_size("cache", .value.as_uint64 = 64),
+      optly_flag_duration("timeout", .description = "timeout"),
+      optly_flag_rate("rate", .description = "rate"),
+      optly_flag_cpuset("cpus", .description = "cpus")
+    )
+  );
+
+  char *bad[] = ARGV("app", "--cache=4X", "--cache=0.5B", "--cache=17EiB", "--timeout=5", "--timeout=3fortnights", "--rate=10k/year", "--cpus=7-3", "--cpus=1024", "--cpus=1,,2");
+
+  errs = optly_parse_args(count_argc(bad), bad, &fresh);
+  assert_err_count(&errs, 9);
+  assert_err_at(&errs, 0, OPTLY_ERR_INVALID_VALUE, "4X");
+  assert_err_at(&errs, 1, OPTLY_ERR_INVALID_VALUE, "0.5B");
+  assert_err_at(&errs, 2, OPTLY_ERR_INVALID_VALUE, "17EiB");
+  assert_err_at(&errs, 3, OPTLY_ERR_INVALID_VALUE, "5");
+  assert_err_at(&errs, 4, OPTLY_ERR_INVALID_VALUE, "3fortnights");
+  assert_err_at(&errs, 5, OPTLY_ERR_INVALID_VALUE, "10k/year");
+  assert_err_at(&errs, 6, OPTLY_ERR_INVALID_VALUE, "7-3");
+  assert_err_at(&errs, 7, OPTLY_ERR_INVALID_VALUE, "1024");
+  assert_err_at(&errs, 8, OPTLY_ERR_INVALID_VALUE, "1,,2");
+  ASSERT_TRUE(optly_flag_value_size(&fresh, "cache") == 64);
+}
+
+typedef struct {
+  char     host[32];
+  uint16_t port;
+} Endpoint;
+
+static int endpoint_conversions = 0;
+
+static const char *convert_endpoint(const OptlyFlag *flag, const char *value, void *out) {
+  (void)flag;
+  Endpoint   *ep    = out;
+  const char *colon = strrchr(value, ':');
+
+  endpoint_conversions++;
+
+  if (!colon || colon == value || (size_t)(colon - value) >= sizeof(ep->host)) return "expected host:port";
+
+  char *end;
+  long  port = strtol(colon + 1, &end, 10);
+
+  if (*end || port <= 0 || port > 65535) return "bad port";
+
+  memcpy(ep->host, value, (size_t)(colon - value));
+  ep->host[colon - value] = '\0';
+  ep->port                = (uint16_t)port;
+  return NULL;
+}
+
+static void format_endpoint(const OptlyFlag *flag, const void *value, char *buf, size_t size) {
+  (void)flag;
+  const Endpoint *ep = value;
+  snprintf(buf, size, "%s:%u", ep->host, ep->port);
+}
+
+static const OptlyConverter endpoint_type = {
+  .type_name = "<host:port>",
+  .size      = sizeof(Endpoint),
+  .align     = OPTLY_ALIGNOF(Endpoint),
+  .convert   = convert_endpoint,
+  .format    = format_endpoint,
+};
+
+static void test_custom_converter(void) {
+  Endpoint listen   = {"0.0.0.0", 80};
+  Endpoint upstream = {"", 0};
+
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_custom("listen", .value.as_custom = &listen, .converter = &endpoint_type),
+      optly_flag_custom("upstream", .bind.as_custom = &upstream, .converter = &endpoint_type)
+    )
+  );
+
+  char *argv[] = ARGV("app", "--listen=127.0.0.1:8080", "--upstream", "db:5432");
+
+  OptlyErrors errs = optly_parse_args(count_argc(argv), argv, &cmd);
+  assert_err_count(&errs, 0);
+  ASSERT_EQ_INT(endpoint_conversions, 2);
+  ASSERT_TRUE(optly_flag_value_custom(&cmd, "listen") == &listen);
+  ASSERT_EQ_STR(listen.host, "127.0.0.1");
+  ASSERT_EQ_INT(listen.port, 8080);
+  ASSERT_EQ_STR(upstream.host, "db");
+  ASSERT_EQ_INT(upstream.port, 5432);
+
+  char        buf[2048];
+  OptlyResult res   = optly_result(buf, sizeof(buf));
+  char       *bad[] = ARGV("app", "--listen=nowhere", "--listen=:1");
+
+  ASSERT_TRUE(!optly_parse(&cmd, count_argc(bad), bad, &res));
+  assert_err_count(&res.errors, 2);
+  assert_err_at(&res.errors, 0, OPTLY_ERR_INVALID_VALUE, "nowhere");
+  assert_err_at(&res.errors, 1, OPTLY_ERR_INVALID_VALUE, ":1");
+  // Failed conversion keeps previous value
+  ASSERT_EQ_INT(listen.port, 8080);
+}
+
+static void test_list_flags(void) {
+  char     *include_items[8];
+  uint32_t  shard_items[4];
+  OptlyList includes = {include_items, 0, 8};
+  OptlyList shards   = {shard_items, 0, 4};
+  char     *default_items[] = {"all"};
+  OptlyList features         = {default_items, 1, 1};
+
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_string("include", 'I', .list = &includes),
+      optly_flag_uint32("shard", .list = &shards, .separator = ','),
+      optly_flag_string("feature", .list = &features, .separator = ','),
+      optly_flag_bool("verbose", 'v')
+    )
+  );
+
+  // Separated values are split in place, so they must be writable
+  char  shard_arg[] = "--shard=1,0x2,3";
+  char *argv[]      = ARGV("app", "-I", "a", shard_arg, "-v", "-I=b", "--include", "c", "--shard", "4");
+
+  OptlyErrors errs = optly_parse_args(count_argc(argv), argv, &cmd);
+  assert_err_count(&errs, 0);
+  ASSERT_EQ_INT(includes.count, 3);
+  ASSERT_EQ_STR(optly_list_at(&includes, char *, 0), "a");
+  ASSERT_EQ_STR(optly_list_at(&includes, char *, 1), "b");
+  ASSERT_EQ_STR(optly_list_at(&includes, char *, 2), "c");
+  ASSERT_TRUE(optly_flag_value_list(&cmd, "shard") == &shards);
+  ASSERT_EQ_INT(shards.count, 4);
+  ASSERT_EQ_INT(shard_items[0] + shard_items[1] * 10 + shard_items[2] * 100 + shard_items[3] * 1000, 4321);
+  // Not given list keeps its default
+  ASSERT_EQ_INT(features.count, 1);
+
+  // Thousands of values end up in one array without per-value allocations
+  static char *many[4096 * 2 + 2];
+  static char  names[4096][16];
+
+  many[0] = "app";
+  for (int i = 0; i < 4096; i++) {
+    snprintf(names[i], sizeof(names[i]), "%d", i);
+    many[1 + i * 2] = "--shard";
+    many[2 + i * 2] = names[i];
+  }
+
+  static char mem[1 << 16];
+  OptlyResult res   = optly_result(mem, sizeof(mem));
+  OptlyHandle shard = optly_flag_handle(&cmd, "shard");
+  OptlyHandle feat  = optly_flag_handle(&cmd, "feature");
+
+  ASSERT_TRUE(optly_parse(&cmd, 4096 * 2 + 1, many, &res));
+
+  const OptlyList *parsed = optly_result_flag(res.commands, shard).as_list;
+  ASSERT_EQ_INT(parsed->count, 4096);
+  ASSERT_EQ_INT(optly_list_at(parsed, uint32_t, 4095), 4095);
+  ASSERT_TRUE(optly_result_flag(res.commands, feat).as_list == &features);
+
+  char  bad_first[]  = "--shard=1,x,3";
+  char  bad_second[] = "--shard=5,6,7";
+  char *bad[]        = ARGV("app", bad_first, bad_second);
+
+  errs = optly_parse_args(count_argc(bad), bad, &cmd);
+  assert_err_count(&errs, 2);
+  assert_err_at(&errs, 0, OPTLY_ERR_INVALID_VALUE, "x");
+  // 1, 3, 5, 6 fit, 7 doesn't
+  assert_err_at(&errs, 1, OPTLY_ERR_OUT_OF_MEMORY, "shard");
+  ASSERT_EQ_INT(shards.count, 4);
+  ASSERT_EQ_INT(shard_items[3], 6);
+
+  // Legacy API fills caller's list directly, parse buffer doesn't limit it
+  static char *big_items[8192];
+  OptlyList    big = {big_items, 0, 8192};
+
+  cmd.flags[0].list = &big;
+  many[0]           = "app";
+  for (int i = 0; i < 3000; i++) {
+    many[1 + i * 2] = "-I";
+    many[2 + i * 2] = names[i];
+  }
+
+  errs = optly_parse_args(3000 * 2 + 1, many, &cmd);
+  assert_err_count(&errs, 0);
+  ASSERT_EQ_INT(big.count, 3000);
+  ASSERT_EQ_STR(optly_list_at(&big, char *, 2999), "2999");
+}
+
+static void test_constraint_groups(void) {
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_bool("json", .description = "json"),
+      optly_flag_bool("yaml", .description = "yaml"),
+      optly_flag_string("user", .description = "user"),
+      optly_flag_string("password", .description = "password"),
+      optly_flag_string("tls-cert", .description = "cert"),
+      optly_flag_string("tls-key", .description = "key"),
+      optly_flag_string("input", .required = true),
+      optly_flag_bool("stdin", .description = "stdin")
+    ),
+    .groups = optly_groups(
+      optly_group(OPTLY_GROUP_EXCLUSIVE, "json", "yaml"),
+      optly_group(OPTLY_GROUP_REQUIRES, "password", "user"),
+      optly_group(OPTLY_GROUP_ALL_OR_NONE, "tls-cert", "tls-key"),
+      {OPTLY_GROUP_ANY_OF, (const char *[]){"input", "stdin", NULL}, "source"}
+    )
+  );
+
+  char        mem[4096];
+  OptlyResult res  = optly_result(mem, sizeof(mem));
+  char       *ok[] = ARGV("app", "--json", "--user=me", "--password=x", "--input=a");
+
+  ASSERT_TRUE(optly_parse(&cmd, count_argc(ok), ok, &res));
+
+  char *bad[] = ARGV("app", "--json", "--yaml", "--password=x", "--tls-key=k");
+  res         = optly_result(mem, sizeof(mem));
+
+  ASSERT_FALSE(optly_parse(&cmd, count_argc(bad), bad, &res));
+  assert_err_count(&res.errors, 5);
+  assert_err_at(&res.errors, 0, OPTLY_ERR_MISSING_REQUIRED, "input");
+  assert_err_at(&res.errors, 1, OPTLY_ERR_CONSTRAINT, "json");
+  assert_err_at(&res.errors, 2, OPTLY_ERR_CONSTRAINT, "password");
+  assert_err_at(&res.errors, 3, OPTLY_ERR_CONSTRAINT, "tls-cert");
+  assert_err_at(&res.errors, 4, OPTLY_ERR_CONSTRAINT, "source");
+
+  // Compiled command gets the same answers from precomputed masks
+  char       buf[4096];
+  OptlyArena arena = optly_arena(buf, sizeof(buf));
+
+  ASSERT_TRUE(optly_compile(&cmd, &arena));
+  ASSERT_TRUE(arena.used <= optly_compile_size(&cmd));
+
+  res = optly_result(mem, sizeof(mem));
+  ASSERT_FALSE(optly_parse(&cmd, count_argc(bad), bad, &res));
+  assert_err_count(&res.errors, 5);
+
+  char *fixed[] = ARGV("app", "--yaml", "--stdin", "--input=-", "--tls-key=k", "--tls-cert=c");
+  res           = optly_result(mem, sizeof(mem));
+  ASSERT_TRUE(optly_parse(&cmd, count_argc(fixed), fixed, &res));
+
+  OptlyCommand broken = optly_command(
+    "app",
+    .flags  = optly_flags(optly_flag_bool("a", .description = "a")),
+    .groups = optly_groups(optly_group(OPTLY_GROUP_ONE_OF, "a", "nope"))
+  );
+
+  ASSERT_FALSE(optly_compile(&broken, &arena));
+}
+
 static void test_commands_and_command_flags(void) {
   OptlyCommand cmd = optly_command(
     "app",
@@ -273,71 +863,428 @@ static void test_positionals_and_delimiter(void) {
   ASSERT_EQ_STR(p->values[2], "b.txt");
 }
 
-static void test_error_unknown_flag_missing_invalid(void) {
-  OptlyCommand cmd = optly_command(
-    "app",
-    .flags = optly_flags(
-      optly_flag_uint32("threads", .shortname = 't'),
-      optly_flag_int32("num", .shortname = 'n')
-    )
-  );
-
-  char       *argv[] = ARGV("app", "--unknown", "--threads", "--num=abc");
-  OptlyErrors errs   = optly_parse_args(count_argc(argv), argv, &cmd);
-  assert_err_count(&errs, 3);
-  assert_err_at(&errs, 0, OPTLY_ERR_UNKNOWN_FLAG, "--unknown");
-  assert_err_at(&errs, 1, OPTLY_ERR_MISSING_VALUE, "threads");
-  assert_err_at(&errs, 2, OPTLY_ERR_INVALID_VALUE, "abc");
-}
-
-static void test_error_unknown_command(void) {
-  OptlyCommand cmd = optly_command(
-    "app",
-    .commands = optly_commands(optly_command("run", NULL))
-  );
-
-  char       *argv[] = ARGV("app", "build");
-  OptlyErrors errs   = optly_parse_args(count_argc(argv), argv, &cmd);
-  assert_err_count(&errs, 1);
-  assert_err_at(&errs, 0, OPTLY_ERR_UNKNOWN_COMMAND, "build");
-}
-
-static void test_error_required_and_batch_non_bool(void) {
-  OptlyCommand cmd = optly_command(
-    "app",
-    .flags = optly_flags(
-      optly_flag_string("token", .shortname = 'T', .required = true),
-      optly_flag_uint32("threads", .shortname = 't')
-    )
-  );
-
-  char       *argv[] = ARGV("app", "-tT");
-  OptlyErrors errs   = optly_parse_args(count_argc(argv), argv, &cmd);
-
-  // -tT => batch, but t is not bool => OPTLY_ERR_BATCH_NON_BOOL
-  // T required token not found => OPTLY_ERR_MISSING_REQUIRED
-  assert_err_count(&errs, 3);
-  assert_err_at(&errs, 0, OPTLY_ERR_BATCH_NON_BOOL, "t");
-  assert_err_at(&errs, 1, OPTLY_ERR_BATCH_NON_BOOL, "T");
-  assert_err_at(&errs, 2, OPTLY_ERR_MISSING_REQUIRED, "token");
-}
-
-static void test_error_positionals_too_few_and_too_many(void) {
-  // too few
+static void test_positionals_distribution(void) {
+  // Extra values are given back to front up to each max, first positional too
   {
     OptlyCommand cmd = optly_command(
       "app",
       .positionals = optly_positionals(
-        optly_positional("src", .min = 1, .max = 1)
+        optly_positional("src", .min = 1, .max = 0),
+        optly_positional("mid", .min = 1, .max = 2),
+        optly_positional("dst", .min = 1, .max = 1)
       )
     );
 
-    char       *argv[] = ARGV("app");
+    char       *argv[] = ARGV("app", "a", "b", "c", "d", "e", "f");
     OptlyErrors errs   = optly_parse_args(count_argc(argv), argv, &cmd);
-    assert_err_count(&errs, 1);
-    assert_err_at(&errs, 0, OPTLY_ERR_POSITIONAL_TOO_FEW, "src");
+    assert_err_count(&errs, 0);
+
+    OptlyPositional *src = optly_get_positional(&cmd, "src");
+    OptlyPositional *mid = optly_get_positional(&cmd, "mid");
+    OptlyPositional *dst = optly_get_positional(&cmd, "dst");
+    ASSERT_EQ_INT(src->count, 3);
+    ASSERT_EQ_STR(src->values[0], "a");
+    ASSERT_EQ_STR(src->values[2], "c");
+    ASSERT_EQ_INT(mid->count, 2);
+    ASSERT_EQ_STR(mid->values[0], "d");
+    ASSERT_EQ_STR(mid->values[1], "e");
+    ASSERT_EQ_INT(dst->count, 1);
+    ASSERT_EQ_STR(dst->values[0], "f");
   }
-  // too many
+  // Optional positionals are filled in order
+  {
+    OptlyCommand cmd = optly_command(
+      "app",
+      .positionals = optly_positionals(
+        optly_positional("first", .min = 0, .max = 2),
+        optly_positional("second", .min = 0, .max = 1)
+      )
+    );
+
+    char       *argv[] = ARGV("app", "a");
+    OptlyErrors errs   = optly_parse_args(count_argc(argv), argv, &cmd);
+    assert_err_count(&errs, 0);
+    ASSERT_EQ_INT(optly_get_positional(&cmd, "first")->count, 1);
+    ASSERT_EQ_INT(optly_get_positional(&cmd, "second")->count, 0);
+  }
+  // Thousands of values after '--' go in one append
+  {
+    const OptlyCommand schema = optly_command(
+      "app",
+      .positionals = optly_positionals(
+        optly_positional("files", .min = 1, .max = 0),
+        optly_positional("dst", .min = 1, .max = 1)
+      )
+    );
+
+    static char *argv[4003];
+    argv[0] = "app";
+    argv[1] = "--";
+
+    for (size_t i = 2; i < 4002; i++) {
+      argv[i] = "file";
+    }
+
+    argv[4001] = "out";
+
+    static char buf[1 << 16];
+    OptlyResult res = optly_result(buf, sizeof(buf));
+
+    ASSERT_TRUE(optly_parse(&schema, 4002, argv, &res));
+    ASSERT_EQ_INT(optly_result_positional(res.commands, "files")->count, 3999);
+    ASSERT_EQ_STR(optly_result_positional(res.commands, "dst")->items[0], "out");
+  }
+  // Two variadic positionals are an error, not an exit
+  {
+    const OptlyCommand schema = optly_command(
+      "app",
+      .positionals = optly_positionals(
+        optly_positional("src", .min = 0, .max = 0),
+        optly_positional("dst", .min = 0, .max = 0)
+      )
+    );
+
+    char        buf[1024];
+    OptlyResult res    = optly_result(buf, sizeof(buf));
+    char       *argv[] = ARGV("app", "a", "b");
+
+    ASSERT_FALSE(optly_parse(&schema, count_argc(argv), argv, &res));
+    assert_err_count(&res.errors, 1);
+    assert_err_at(&res.errors, 0, OPTLY_ERR_DUPLICATE_VARIADIC, "dst");
+  }
+}
+
+static bool grow_into_blocks(OptlyArena *arena, size_t need) {
+  static unsigned char blocks[8][1 << 14];
+  size_t              *next = arena->ctx;
+
+  if (*next == 8 || need > sizeof(blocks[0])) {
+    return false;
+  }
+
+  arena->base = blocks[(*next)++];
+  arena->size = sizeof(blocks[0]);
+  arena->used = 0;
+  return true;
+}
+
+static void test_positionals_unbounded(void) {
+  enum { VALUES = 100000 };
+
+  static char *argv[VALUES + 3];
+  argv[0] = "app";
+  argv[1] = "-v";
+
+  for (size_t i = 0; i < VALUES; i++) {
+    argv[i + 2] = i % 2 ? "odd" : "even";
+  }
+
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags       = optly_flags(optly_flag_bool("verbose", .shortname = 'v')),
+    .positionals = optly_positionals(optly_positional("files", .min = 1, .max = 0))
+  );
+
+  OptlyErrors errs = optly_parse_args(VALUES + 2, argv, &cmd);
+  assert_err_count(&errs, 0);
+
+  OptlyPositional *files = optly_get_positional(&cmd, "files");
+  ASSERT_EQ_INT(files->count, VALUES);
+  ASSERT_EQ_STR(files->values[0], "even");
+  ASSERT_EQ_STR(files->values[VALUES - 1], "odd");
+#ifdef OPTLY_ARGV_POSITIONALS
+  // Values are moved to the front of argv
+  ASSERT_TRUE(files->values == argv + 1);
+  // Flag moved over is behind them, not overwritten
+  ASSERT_EQ_STR(argv[VALUES + 1], "-v");
+#else
+  // argv is left as is
+  ASSERT_EQ_STR(argv[1], "-v");
+  ASSERT_EQ_STR(argv[2], "even");
+#endif
+
+  // Every argument is still there once
+  OptlyCommand mixed = optly_command(
+    "app",
+    .flags       = optly_flags(optly_flag_bool("verbose", .shortname = 'v'), optly_flag_string("out", .shortname = 'o')),
+    .positionals = optly_positionals(optly_positional("files", .min = 1, .max = 0))
+  );
+  char *order[] = ARGV("app", "-v", "a", "-o", "x", "-v", "b", "c", "--", "-d");
+
+  errs = optly_parse_args(count_argc(order), order, &mixed);
+  assert_err_count(&errs, 0);
+  files = optly_get_positional(&mixed, "files");
+  ASSERT_EQ_INT(files->count, 4);
+  ASSERT_EQ_STR(files->values[3], "-d");
+  // Values of previous call are still there
+  ASSERT_EQ_STR(optly_get_positional(&cmd, "files")->values[VALUES - 1], "odd");
+
+#ifdef OPTLY_ARGV_POSITIONALS
+  ASSERT_EQ_STR(order[1], "a");
+  ASSERT_EQ_STR(order[2], "b");
+  ASSERT_EQ_STR(order[3], "c");
+  ASSERT_EQ_STR(order[4], "-d");
+
+  const char *rest[] = {"-v", "-o", "x", "-v", "--"};
+  int         seen[5] = {0};
+
+  for (size_t i = 5; i < count_argc(order); i++) {
+    for (int j = 0; j < 5; j++) {
+      if (!seen[j] && strcmp(order[i], rest[j]) == 0) {
+        seen[j] = 1;
+        break;
+      }
+    }
+  }
+
+  ASSERT_TRUE(seen[0] && seen[1] && seen[2] && seen[3] && seen[4]);
+#else
+  ASSERT_EQ_STR(order[1], "-v");
+  ASSERT_EQ_STR(order[2], "a");
+#endif
+
+  // Result mode gets more memory through grow callback
+  const OptlyCommand schema = optly_command(
+    "app",
+    .positionals = optly_positionals(optly_positional("files", .min = 1, .max = 0))
+  );
+
+  char        *small[] = ARGV("app", "a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k");
+  char         buf[256];
+  size_t       used_blocks = 0;
+  OptlyResult  res         = optly_result(buf, sizeof(buf));
+
+  res.arena.grow = grow_into_blocks;
+  res.arena.ctx  = &used_blocks;
+
+  argv[0] = "app";
+
+  for (size_t i = 0; i < 1000; i++) {
+    argv[i + 1] = small[1 + i % 11];
+  }
+
+  ASSERT_TRUE(optly_parse(&schema, 1001, argv, &res));
+  ASSERT_TRUE(used_blocks > 0);
+  ASSERT_EQ_INT(optly_result_positional(res.commands, "files")->count, 1000);
+  ASSERT_EQ_STR(optly_result_positional(res.commands, "files")->items[999], "j");
+
+  // Without callback it is reported
+  OptlyResult tight = optly_result(buf, sizeof(buf));
+  ASSERT_FALSE(optly_parse(&schema, 1001, argv, &tight));
+  assert_err_count(&tight.errors, 1);
+  ASSERT_EQ_INT(optly_errors_at(&tight.errors, 0).kind, OPTLY_ERR_OUT_OF_MEMORY);
+}
+
+typedef struct {
+  size_t count;
+  int    first_index;
+  int    last_index;
+  char  *last;
+} StreamStats;
+
+static void count_value(const OptlyCommand *command, char *value, int index, void *ctx) {
+  StreamStats *stats = ctx;
+
+  if (stats->count++ == 0) {
+    stats->first_index = index;
+  }
+
+  stats->last_index = index;
+  stats->last       = value;
+  (void)command;
+}
+
+static void test_positionals_typed(void) {
+  uint64_t  id_items[8];
+  OptlyList ids = {id_items, 0, 8};
+
+  OptlyCommand cmd = optly_command(
+    "app",
+    .positionals = optly_positionals(
+      optly_positional("scale", .min = 1, .max = 1, .type = OPTLY_TYPE_DOUBLE),
+      optly_positional("ids", .min = 1, .max = 0, .type = OPTLY_TYPE_UINT64, .list = &ids)
+    )
+  );
+
+  char *argv[] = ARGV("app", "0.5", "7", "12345678", "1234567890123456789", "0x10", "10000000000000000009");
+
+  OptlyErrors errs = optly_parse_args(count_argc(argv), argv, &cmd);
+  assert_err_count(&errs, 0);
+  ASSERT_EQ_INT(ids.count, 5);
+  ASSERT_TRUE(id_items[0] == 7 && id_items[1] == 12345678 && id_items[2] == 1234567890123456789ull);
+  ASSERT_TRUE(id_items[3] == 16 && id_items[4] == 10000000000000000009ull);
+  // Strings are still there
+  ASSERT_EQ_STR(optly_get_positional(&cmd, "ids")->values[1], "12345678");
+
+  char        mem[2048];
+  OptlyResult res   = optly_result(mem, sizeof(mem));
+  char       *bad[] = ARGV("app", "2", "1", "12345678x", "99999999999999999999");
+
+  ASSERT_FALSE(optly_parse(&cmd, count_argc(bad), bad, &res));
+  assert_err_count(&res.errors, 2);
+  assert_err_at(&res.errors, 0, OPTLY_ERR_INVALID_VALUE, "12345678x");
+  assert_err_at(&res.errors, 1, OPTLY_ERR_INVALID_VALUE, "99999999999999999999");
+
+  const OptlyValues *scale = optly_result_values(res.commands, optly_positional_handle(&cmd, "scale"));
+  const OptlyValues *typed = optly_result_values(res.commands, optly_positional_handle(&cmd, "ids"));
+  ASSERT_TRUE(((double *)scale->typed)[0] == 2.0);
+  ASSERT_EQ_INT(typed->count, 3);
+  ASSERT_TRUE(((uint64_t *)typed->typed)[0] == 1);
+
+  // Legacy API converts right into caller's list, parse buffer doesn't limit it
+  static uint64_t many_items[20000];
+  static char    *many[10000 + 2];
+  static char     names[10000][16];
+  OptlyList       many_ids = {many_items, 0, 20000};
+
+  cmd.positionals[1].list = &many_ids;
+  many[0]                 = "app";
+  many[1]                 = "1";
+  for (int i = 0; i < 10000; i++) {
+    snprintf(names[i], sizeof(names[i]), "%d", i);
+    many[i + 2] = names[i];
+  }
+
+  errs = optly_parse_args(10000 + 2, many, &cmd);
+  assert_err_count(&errs, 0);
+  ASSERT_EQ_INT(many_ids.count, 10000);
+  ASSERT_TRUE(many_items[9999] == 9999);
+
+  // What doesn't fit is still checked
+  char *over[] = ARGV("app", "1", "1", "2", "x");
+  many_ids     = (OptlyList){many_items, 0, 2};
+
+  errs = optly_parse_args(count_argc(over), over, &cmd);
+  assert_err_count(&errs, 2);
+  assert_err_at(&errs, 0, OPTLY_ERR_OUT_OF_MEMORY, "ids");
+  assert_err_at(&errs, 1, OPTLY_ERR_INVALID_VALUE, "x");
+  ASSERT_EQ_INT(many_ids.count, 2);
+
+  // Enum and custom positionals are refused, not crashed on
+  OptlyCommand enums = optly_command(
+    "app",
+    .positionals = optly_positionals(optly_positional("mode", .min = 1, .max = 1, .type = OPTLY_TYPE_ENUM))
+  );
+  char *mode[] = ARGV("app", "fast");
+
+  errs = optly_parse_args(count_argc(mode), mode, &enums);
+  assert_err_count(&errs, 1);
+  assert_err_at(&errs, 0, OPTLY_ERR_INVALID_VALUE, "mode");
+}
+
+static void test_positionals_streaming(void) {
+  StreamStats stats = {0};
+
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags       = optly_flags(optly_flag_bool("verbose", .shortname = 'v')),
+    .positionals = optly_positionals(
+      optly_positional("dst", .min = 1, .max = 1),
+      optly_positional("files", .min = 2, .max = 0, .on_value = count_value, .ctx = &stats)
+    )
+  );
+
+  char       *argv[] = ARGV("app", "out", "-v", "a", "b", "--", "-c", "d");
+  OptlyErrors errs   = optly_parse_args(count_argc(argv) - 1, argv, &cmd);
+  assert_err_count(&errs, 0);
+
+  ASSERT_EQ_INT(stats.count, 4);
+  ASSERT_EQ_INT(stats.first_index, 3);
+  ASSERT_EQ_INT(stats.last_index, 7);
+  ASSERT_EQ_STR(stats.last, "d");
+
+  OptlyPositional *dst   = optly_get_positional(&cmd, "dst");
+  OptlyPositional *files = optly_get_positional(&cmd, "files");
+  ASSERT_EQ_INT(dst->count, 1);
+  ASSERT_EQ_STR(dst->values[0], "out");
+  ASSERT_EQ_INT(files->count, 4);
+  ASSERT_TRUE(files->values == NULL);
+
+  // min is still validated from counter
+  const OptlyCommand schema = optly_command(
+    "app",
+    .positionals = optly_positionals(
+      optly_positional("files", .min = 2, .max = 0, .on_value = count_value, .ctx = &stats)
+    )
+  );
+
+  char        buf[512];
+  OptlyResult res     = optly_result(buf, sizeof(buf));
+  char       *argv2[] = ARGV("app", "only");
+
+  stats = (StreamStats){0};
+  ASSERT_FALSE(optly_parse(&schema, count_argc(argv2) - 1, argv2, &res));
+  assert_err_count(&res.errors, 1);
+  assert_err_at(&res.errors, 0, OPTLY_ERR_POSITIONAL_TOO_FEW, "files");
+  ASSERT_EQ_INT(stats.count, 1);
+  ASSERT_EQ_INT(stats.first_index, 1);
+}
+
+static void test_error_unknown_flag_missing_invalid(void) {
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_uint32("threads", .shortname = 't'),
+      optly_flag_int32("num", .shortname = 'n')
+    )
+  );
+
+  char       *argv[] = ARGV("app", "--unknown", "--threads", "--num=abc");
+  OptlyErrors errs   = optly_parse_args(count_argc(argv), argv, &cmd);
+  assert_err_count(&errs, 3);
+  assert_err_at(&errs, 0, OPTLY_ERR_UNKNOWN_FLAG, "--unknown");
+  assert_err_at(&errs, 1, OPTLY_ERR_MISSING_VALUE, "threads");
+  assert_err_at(&errs, 2, OPTLY_ERR_INVALID_VALUE, "abc");
+}
+
+static void test_error_unknown_command(void) {
+  OptlyCommand cmd = optly_command(
+    "app",
+    .commands = optly_commands(optly_command("run", NULL))
+  );
+
+  char       *argv[] = ARGV("app", "build");
+  OptlyErrors errs   = optly_parse_args(count_argc(argv), argv, &cmd);
+  assert_err_count(&errs, 1);
+  assert_err_at(&errs, 0, OPTLY_ERR_UNKNOWN_COMMAND, "build");
+}
+
+static void test_error_required_and_batch_non_bool(void) {
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_string("token", .shortname = 'T', .required = true),
+      optly_flag_uint32("threads", .shortname = 't')
+    )
+  );
+
+  char       *argv[] = ARGV("app", "-tT");
+  OptlyErrors errs   = optly_parse_args(count_argc(argv), argv, &cmd);
+
+  // -tT => batch, but t is not bool => OPTLY_ERR_BATCH_NON_BOOL
+  // T required token not found => OPTLY_ERR_MISSING_REQUIRED
+  assert_err_count(&errs, 3);
+  assert_err_at(&errs, 0, OPTLY_ERR_BATCH_NON_BOOL, "t");
+  assert_err_at(&errs, 1, OPTLY_ERR_BATCH_NON_BOOL, "T");
+  assert_err_at(&errs, 2, OPTLY_ERR_MISSING_REQUIRED, "token");
+}
+
+static void test_error_positionals_too_few_and_too_many(void) {
+  // too few
+  {
+    OptlyCommand cmd = optly_command(
+      "app",
+      .positionals = optly_positionals(
+        optly_positional("src", .min = 1, .max = 1)
+      )
+    );
+
+    char       *argv[] = ARGV("app");
+    OptlyErrors errs   = optly_parse_args(count_argc(argv), argv, &cmd);
+    assert_err_count(&errs, 1);
+    assert_err_at(&errs, 0, OPTLY_ERR_POSITIONAL_TOO_FEW, "src");
+  }
+  // too many
   {
     OptlyCommand cmd = optly_command(
       "app",
@@ -433,17 +1380,852 @@ static void test_enum_mixed_with_other_flags(void) {
   ASSERT_EQ_INT(optly_flag_value_uint32(&cmd, "threads"), 8);
 }
 
+static void test_enum_index(void) {
+  char *regions[] = {"eu-west-1", "af-south-1", "ap-east-1", "ap-south-1", "ap-northeast-1", "ap-northeast-2", "ca-central-1", "eu-central-1",
+                     "eu-north-1", "eu-south-1", "eu-west-1", "eu-west-2", "eu-west-3", "me-south-1", "sa-east-1", "us-east-1",
+                     "us-east-2", "us-west-1", "us-west-2", NULL};
+
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_enum("log", 'l', optly_enum_values("warn", "debug", "info", "warn")),
+      optly_flag_enum("region", .value.as_enum = regions),
+      optly_flag_enum("color", 'c', optly_enum_values(NULL, "auto", "always", "never"))
+    )
+  );
+
+  char       *argv[] = ARGV("app", "--region=us-west-2");
+  OptlyErrors errs   = optly_parse_args(count_argc(argv), argv, &cmd);
+  assert_err_count(&errs, 0);
+  ASSERT_EQ_INT(optly_flag_value_enum_index(&cmd, "log"), 2);
+  ASSERT_EQ_INT(optly_flag_value_enum_index(&cmd, "region"), 17);
+  ASSERT_TRUE(optly_flag_value_enum_index(&cmd, "color") == OPTLY_ENUM_NONE);
+
+  // Big enum gets hashed table, same answers
+  char       buf[4096];
+  OptlyArena arena = optly_arena(buf, sizeof(buf));
+
+  ASSERT_TRUE(optly_compile(&cmd, &arena));
+  ASSERT_TRUE(cmd.index->enums && cmd.index->enums[1].slots && !cmd.index->enums[0].slots);
+  ASSERT_TRUE(arena.used <= optly_compile_size(&cmd));
+
+  char        mem[4096];
+  OptlyResult res    = optly_result(mem, sizeof(mem));
+  char       *more[] = ARGV("app", "--region=ap-east-1", "-c", "never");
+  OptlyHandle region = optly_flag_handle(&cmd, "region");
+  OptlyHandle color  = optly_flag_handle(&cmd, "color");
+
+  ASSERT_TRUE(optly_parse(&cmd, count_argc(more), more, &res));
+  ASSERT_EQ_INT(optly_result_enum(res.commands, region), 1);
+  ASSERT_EQ_INT(optly_result_enum(res.commands, color), 2);
+  ASSERT_EQ_INT(optly_result_enum(res.commands, optly_flag_handle(&cmd, "log")), 2);
+
+  char *bad[] = ARGV("app", "--region=mars-1");
+  res         = optly_result(mem, sizeof(mem));
+
+  ASSERT_FALSE(optly_parse(&cmd, count_argc(bad), bad, &res));
+  assert_err_at(&res.errors, 0, OPTLY_ERR_INVALID_VALUE, "mars-1");
+}
+
+static void test_compiled_index_matches_scan(void) {
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_bool("a", .shortname = 'a'),
+      optly_flag_bool("b", .shortname = 'b'),
+      optly_flag_uint32("threads", .shortname = 't'),
+      optly_flag_string("name", .shortname = 'n'),
+      optly_flag_bool("no-short", .description = "No short name")
+    ),
+    .commands = optly_commands(
+      optly_command(
+        "run",
+        .flags = optly_flags(
+          optly_flag_uint16("port", .shortname = 'p')
+        )
+      )
+    )
+  );
+
+  char       buf[4096];
+  OptlyArena arena = optly_arena(buf, sizeof(buf));
+
+  ASSERT_TRUE(optly_compile_size(&cmd) <= sizeof(buf));
+  ASSERT_TRUE(optly_compile(&cmd, &arena));
+  ASSERT_TRUE(cmd.index != NULL);
+  ASSERT_TRUE(cmd.commands[0].index != NULL);
+
+  char       *argv[] = ARGV("app", "-ab", "--threads=8", "-n", "Bob", "--no-short", "--nope", "run", "--port", "9000");
+  OptlyErrors errs   = optly_parse_args(count_argc(argv), argv, &cmd);
+  assert_err_count(&errs, 1);
+  assert_err_at(&errs, 0, OPTLY_ERR_UNKNOWN_FLAG, "--nope");
+  ASSERT_TRUE(optly_flag_value_bool(&cmd, "a"));
+  ASSERT_TRUE(optly_flag_value_bool(&cmd, "b"));
+  ASSERT_TRUE(optly_flag_value_bool(&cmd, "no-short"));
+  ASSERT_EQ_INT(optly_flag_value_uint32(&cmd, "threads"), 8);
+  ASSERT_EQ_STR(optly_flag_value_string(&cmd, "name"), "Bob");
+  ASSERT_EQ_INT(optly_flag_value_uint16(cmd.next_command, "port"), 9000);
+}
+
+static uint32_t match_app_long(const char *name, size_t len) {
+  return len == 7 && memcmp(name, "threads", 7) == 0 ? 1 : 0;
+}
+
+static uint32_t match_run_long(const char *name, size_t len) {
+  return len == 4 && memcmp(name, "port", 4) == 0 ? 1 : 0;
+}
+
+static uint32_t match_no_commands(const char *name, size_t len) {
+  (void)name;
+  (void)len;
+  return 0;
+}
+
+static uint32_t match_app_commands(const char *name, size_t len) {
+  return len == 3 && memcmp(name, "run", 3) == 0 ? 1 : 0;
+}
+
+static void test_generated_index(void) {
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags    = optly_flags(optly_flag_uint32("threads", 't', "Threads")),
+    .commands = optly_commands(
+      optly_command("run", "Run it", .flags = optly_flags(optly_flag_uint16("port", 'p', "Port")))
+    )
+  );
+
+  // Generated code holds switch matchers, position constants and rendered usage
+  FILE *file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  if (!file) return;
+
+  ASSERT_TRUE(optly_generate(&cmd, "app", file));
+  rewind(file);
+
+  static char code[16384];
+  size_t      n = fread(code, 1, sizeof(code) - 1, file);
+  code[n]       = '\0';
+  fclose(file);
+
+  ASSERT_TRUE(strstr(code, "APP_THREADS = 0,") != NULL);
+  ASSERT_TRUE(strstr(code, "#define APP_RUN_PORT_BIT  OPTLY_BIT(APP_RUN_PORT)") != NULL);
+  ASSERT_TRUE(strstr(code, "#define APP_RUN_PORT_WORD OPTLY_WORD(APP_RUN_PORT)") != NULL);
+  ASSERT_TRUE(strstr(code, "if (memcmp(name, \"run\", 3) == 0) return 1;") != NULL);
+  ASSERT_TRUE(strstr(code, "  \"Usage: run [FLAGS]\\n\"\n") != NULL);
+  ASSERT_TRUE(strstr(code, "optly_install(command, app_indexes, 2);") != NULL);
+
+  // Installing indexes like generated ones
+  OptlyIndex app_index = {
+    .shorts = {['t'] = 1}, .match_long = match_app_long, .match_command = match_app_commands,
+    .flags_count = 1, .schema_hash = optly_schema_hash(&cmd),
+  };
+  OptlyIndex run_index = {
+    .shorts = {['p'] = 1}, .match_long = match_run_long, .match_command = match_no_commands, .usage = "run usage\n",
+    .flags_count = 1, .schema_hash = optly_schema_hash(&cmd.commands[0]),
+  };
+  OptlyIndex *indexes[] = {&app_index, &run_index};
+
+  char hash[32];
+  snprintf(hash, sizeof(hash), ".schema_hash   = 0x%08xu,", (unsigned)app_index.schema_hash);
+  ASSERT_TRUE(strstr(code, hash) != NULL);
+
+  ASSERT_FALSE(optly_install(&cmd, indexes, 1));
+  ASSERT_TRUE(cmd.index == NULL);
+
+  // Stale code: flag added, or only its help changed, after generation
+  OptlyFlag stale_flags[] = {
+    optly_flag_uint32("threads", 't', "Threads"),
+    optly_flag_bool("verbose", 'v', "Verbose"),
+    {0},
+  };
+  OptlyFlag *flags = cmd.flags;
+
+  cmd.flags = stale_flags;
+  ASSERT_FALSE(optly_install(&cmd, indexes, 2));
+  stale_flags[1] = (OptlyFlag){0};
+  stale_flags[0] = optly_flag_uint32("threads", 't', "Worker threads");
+  ASSERT_FALSE(optly_install(&cmd, indexes, 2));
+  ASSERT_TRUE(cmd.index == NULL && cmd.commands[0].index == NULL);
+  cmd.flags = flags;
+
+  ASSERT_TRUE(optly_install(&cmd, indexes, 2));
+  ASSERT_TRUE(cmd.commands[0].index == &run_index);
+
+  char       *argv[] = ARGV("app", "-t", "3", "run", "--port=80", "--threads=1");
+  OptlyErrors errs   = optly_parse_args(count_argc(argv), argv, &cmd);
+  assert_err_count(&errs, 1);
+  assert_err_at(&errs, 0, OPTLY_ERR_UNKNOWN_FLAG, "--threads=1");
+  ASSERT_EQ_INT(optly_flag_value_uint32(&cmd, "threads"), 3);
+  ASSERT_EQ_INT(optly_flag_value_uint16(cmd.next_command, "port"), 80);
+
+  char buf[64];
+  ASSERT_EQ_INT(optly_usage_to_buffer(&cmd.commands[0], buf, sizeof(buf)), 10);
+  ASSERT_EQ_STR(buf, "run usage\n");
+}
+
+static void test_generate_ident_collision(void) {
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags = optly_flags(optly_flag_bool("dry-run", 0, "Dry run"), optly_flag_bool("dry_run", 0, "Dry run"))
+  );
+
+  FILE *file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  if (!file) return;
+
+  // Both would be APP_DRY_RUN, nothing is emitted
+  ASSERT_FALSE(optly_generate(&cmd, "app", file));
+  ASSERT_EQ_INT(ftell(file), 0);
+
+  // Constant of one flag is _BIT define of another, also across commands
+  OptlyCommand nested = optly_command(
+    "app",
+    .flags    = optly_flags(optly_flag_bool("run-x-bit", 0, "X")),
+    .commands = optly_commands(optly_command("run", "Run it", .flags = optly_flags(optly_flag_bool("x", 0, "X"))))
+  );
+  ASSERT_FALSE(optly_generate(&nested, "app", file));
+  ASSERT_EQ_INT(ftell(file), 0);
+  fclose(file);
+}
+
+static void test_compile_out_of_memory(void) {
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags = optly_flags(optly_flag_bool("a", .shortname = 'a'))
+  );
+
+  char       buf[16];
+  OptlyArena arena = optly_arena(buf, sizeof(buf));
+  ASSERT_FALSE(optly_compile(&cmd, &arena));
+  ASSERT_TRUE(cmd.index == NULL);
+}
+
+static int g_provided = 0;
+
+static OptlyCommand *provide_deploy(const OptlyCommand *stub) {
+  static OptlyFlag flags[] = {
+    {"replicas", 'r', .type = OPTLY_TYPE_UINT32},
+    NULL_FLAG,
+  };
+  static OptlyCommand deploy = {.name = "deploy", .flags = flags};
+
+  g_provided++;
+
+  (void)stub;
+  return &deploy;
+}
+
+static OptlyCommand *provide_nothing(const OptlyCommand *stub) {
+  (void)stub;
+  g_provided += 100;
+  return NULL;
+}
+
+static void test_lazy_command_provider(void) {
+  OptlyCommand cmd = optly_command(
+    "app",
+    .commands = optly_commands(
+      optly_command("deploy", .provider = provide_deploy),
+      optly_command("broken", .provider = provide_nothing)
+    )
+  );
+
+  char       buf[4096];
+  OptlyArena arena = optly_arena(buf, sizeof(buf));
+  ASSERT_TRUE(optly_compile(&cmd, &arena));
+  ASSERT_TRUE(cmd.commands[0].index == NULL);
+
+  g_provided = 0;
+
+  char       *argv[] = ARGV("app", "deploy", "-r", "3");
+  OptlyErrors errs   = optly_parse_args(count_argc(argv), argv, &cmd);
+  assert_err_count(&errs, 0);
+  ASSERT_EQ_INT(g_provided, 1);
+  ASSERT_TRUE(cmd.next_command != NULL);
+  ASSERT_EQ_STR(cmd.next_command->name, "deploy");
+  ASSERT_EQ_INT(optly_flag_value_uint32(cmd.next_command, "replicas"), 3);
+  // Stub is left as it was
+  ASSERT_TRUE(cmd.commands[0].provider == provide_deploy && cmd.commands[0].flags == NULL);
+
+  // Failed provider is one error, and its name is not taken as positional
+  char *broken[] = ARGV("app", "broken");
+  errs           = optly_parse_args(count_argc(broken), broken, &cmd);
+  assert_err_count(&errs, 1);
+  assert_err_at(&errs, 0, OPTLY_ERR_UNKNOWN_COMMAND, "broken");
+  ASSERT_EQ_INT(g_provided, 101);
+  ASSERT_TRUE(cmd.next_command == NULL);
+
+  // Provider is asked again on every parse and gives the same command
+  char        mem[4096];
+  OptlyResult res = optly_result(mem, sizeof(mem));
+
+  ASSERT_TRUE(optly_parse(&cmd, count_argc(argv), argv, &res));
+  ASSERT_TRUE(optly_parse(&cmd, count_argc(argv), argv, &res));
+  ASSERT_EQ_INT(g_provided, 103);
+  ASSERT_EQ_INT(optly_result_value(res.commands->next, "replicas").as_uint32, 3);
+
+  cmd.positionals = optly_positionals(optly_positional("target", .min = 0, .max = 1));
+
+  res = optly_result(mem, sizeof(mem));
+  ASSERT_FALSE(optly_parse(&cmd, count_argc(broken), broken, &res));
+  assert_err_count(&res.errors, 1);
+  assert_err_at(&res.errors, 0, OPTLY_ERR_UNKNOWN_COMMAND, "broken");
+  ASSERT_EQ_INT(res.commands->positionals[0].count, 0);
+}
+
+static const OptlyFlag ro_flags[] = {
+  {.fullname = "threads", .shortname = 't', .value.as_uint32 = 4, .type = OPTLY_TYPE_UINT32},
+  {.fullname = "verbose", .shortname = 'v', .type = OPTLY_TYPE_BOOL},
+  NULL_FLAG,
+};
+
+static const OptlyPositional ro_positionals[] = {
+  {.name = "file", .min = 1, .max = 1},
+  NULL_POSITIONAL,
+};
+
+static void test_read_only_schema(void) {
+  // Whole schema is copied into a page that is then made read-only, any write into it crashes
+  size_t         page = (size_t)sysconf(_SC_PAGESIZE);
+  unsigned char *mem  = mmap(NULL, page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  ASSERT_TRUE(mem != MAP_FAILED);
+  if (mem == MAP_FAILED) return;
+
+  OptlyFlag       *flags       = (OptlyFlag *)mem;
+  OptlyPositional *positionals = (OptlyPositional *)(flags + 3);
+  OptlyCommand    *commands    = (OptlyCommand *)(positionals + 2);
+  OptlyCommand    *schema      = commands + 2;
+
+  memcpy(flags, ro_flags, sizeof(ro_flags));
+  memcpy(positionals, ro_positionals, sizeof(ro_positionals));
+  commands[0] = (OptlyCommand){.name = "run", .flags = flags, .positionals = positionals};
+  commands[1] = (OptlyCommand)NULL_COMMAND;
+  *schema     = (OptlyCommand){.name = "app", .flags = flags, .commands = commands};
+
+  ASSERT_EQ_INT(mprotect(mem, page, PROT_READ), 0);
+
+  size_t size = optly_result_size(schema);
+  ASSERT_TRUE(size >= 2 * 64);
+
+  char        buf[1024];
+  OptlyResult res = optly_result(buf, sizeof(buf));
+
+  for (int round = 0; round < 2; round++) {
+    char *argv[] = ARGV("app", "-t", "8", "run", "-v", "notes.txt");
+    ASSERT_TRUE(optly_parse(schema, count_argc(argv), argv, &res));
+
+    const OptlyResultCommand *app = res.commands;
+    const OptlyResultCommand *run = app->next;
+
+    ASSERT_EQ_INT(optly_result_flag(app, 0).as_uint32, 8);
+    ASSERT_TRUE(run && optly_result_bool(run, 1));
+    ASSERT_EQ_INT(optly_result_flag(run, 0).as_uint32, 4);
+    ASSERT_EQ_STR(run->positionals[0].items[0], "notes.txt");
+
+    // Every command state is one cache-line aligned block, bits share first line with header
+    ASSERT_EQ_INT((uintptr_t)app % OPTLY_CACHE_LINE, 0);
+    ASSERT_EQ_INT((uintptr_t)run % OPTLY_CACHE_LINE, 0);
+    ASSERT_TRUE((char *)run->bools - (char *)run < OPTLY_CACHE_LINE);
+    ASSERT_TRUE((char *)run->present - (char *)run < OPTLY_CACHE_LINE);
+    ASSERT_TRUE((char *)run->values > (char *)run->present);
+  }
+
+  munmap(mem, page);
+}
+
+static void batch_sink(void *ctx, size_t item, const OptlyError *error) {
+  size_t *bad = ctx;
+
+  // NOTE: Only odd items are broken, each by one unknown flag
+  if (item % 2 == 1 && error->kind == OPTLY_ERR_UNKNOWN_FLAG) {
+    __atomic_fetch_add(bad, 1, __ATOMIC_RELAXED);
+  }
+}
+
+static void test_parse_batch(void) {
+  const OptlyCommand schema = optly_command(
+    "app",
+    .flags    = optly_flags(optly_flag_uint32("threads", 't', "Threads", .value.as_uint32 = 1)),
+    .commands = optly_commands(optly_command("run", "Run", .positionals = optly_positionals(optly_positional("file", .min = 1, .max = 1))))
+  );
+
+  enum { ITEMS = 1000 };
+
+  static char       good[ITEMS][4][32];
+  static char      *argvs[ITEMS][5];
+  static OptlyArgv  inputs[ITEMS];
+  static char       bufs[ITEMS][512];
+  static OptlyResult results[ITEMS];
+
+  for (size_t i = 0; i < ITEMS; i++) {
+    snprintf(good[i][0], sizeof(good[i][0]), "app");
+    snprintf(good[i][1], sizeof(good[i][1]), i % 2 ? "--nope=%zu" : "--threads=%zu", i);
+    snprintf(good[i][2], sizeof(good[i][2]), "run");
+    snprintf(good[i][3], sizeof(good[i][3]), "f%zu", i);
+
+    for (size_t a = 0; a < 4; a++) argvs[i][a] = good[i][a];
+    argvs[i][4] = NULL;
+
+    inputs[i]  = (OptlyArgv){4, argvs[i]};
+    results[i] = optly_result(bufs[i], sizeof(bufs[i]));
+  }
+
+  for (size_t threads = 1; threads <= 4; threads += 3) {
+    size_t     bad   = 0;
+    OptlyBatch batch = {.on_error = batch_sink, .ctx = &bad};
+
+    ASSERT_FALSE(optly_parse_batch(&schema, inputs, ITEMS, results, threads, &batch));
+    ASSERT_EQ_INT(batch.failed, ITEMS / 2);
+    ASSERT_EQ_INT(bad, ITEMS / 2);
+    ASSERT_TRUE(batch.per_second > 0);
+
+    ASSERT_EQ_INT(optly_result_flag(results[10].commands, 0).as_uint32, 10);
+    ASSERT_EQ_STR(results[998].commands->next->positionals[0].items[0], "f998");
+    ASSERT_EQ_INT(results[11].errors.count, 1);
+  }
+
+  // Without results items are only validated
+  OptlyBatch batch = {0};
+  ASSERT_TRUE(optly_parse_batch(&schema, inputs, 1, NULL, 2, &batch));
+  ASSERT_FALSE(optly_parse_batch(&schema, inputs, ITEMS, NULL, 4, &batch));
+  ASSERT_EQ_INT(batch.failed, ITEMS / 2);
+
+  // Validation scratch is sized from schema, so big one fits too
+  static OptlyFlag wide[2001];
+  static char      names[2000][16];
+
+  for (int i = 0; i < 2000; i++) {
+    snprintf(names[i], sizeof(names[i]), "f%d", i);
+    wide[i] = optly_flag_uint32(names[i], 0, "Flag");
+  }
+
+  wide[2000]                 = (OptlyFlag)NULL_FLAG;
+  const OptlyCommand big     = optly_command("app", .flags = wide);
+  char              *last[]  = ARGV("app", "--f1999=1");
+  OptlyArgv          items[] = {{2, last}, {2, last}};
+
+  ASSERT_TRUE(optly_result_size(&big) > OPTLY_PARSE_BUFFER_LENGTH);
+  ASSERT_TRUE(optly_parse_batch(&big, items, 2, NULL, 2, &batch));
+}
+
+static void test_reentrant_parse_keeps_schema_intact(void) {
+  char *levels[] = {"warn", "debug", "warn", NULL};
+
+  const OptlyCommand schema = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_uint32("threads", .shortname = 't', .value.as_uint32 = 4),
+      optly_flag_enum("log", .shortname = 'l', .value.as_enum = levels)
+    ),
+    .commands = optly_commands(
+      optly_command(
+        "cp",
+        .flags       = optly_flags(optly_flag_bool("force", .shortname = 'f')),
+        .positionals = optly_positionals(
+          optly_positional("src", .min = 1, .max = 0),
+          optly_positional("dst", .min = 1, .max = 1)
+        )
+      )
+    )
+  );
+
+  char        buf[2048];
+  OptlyResult first  = optly_result(buf, sizeof(buf));
+  char        buf2[2048];
+  OptlyResult second = optly_result(buf2, sizeof(buf2));
+
+  char *argv1[] = ARGV("app", "-t", "8", "--log=debug", "cp", "-f", "a", "b");
+  char *argv2[] = ARGV("app", "cp", "x", "y");
+
+  ASSERT_TRUE(optly_parse(&schema, count_argc(argv1), argv1, &first));
+  ASSERT_TRUE(optly_parse(&schema, count_argc(argv2), argv2, &second));
+
+  // Schema is not touched
+  ASSERT_EQ_INT(schema.flags[0].value.as_uint32, 4);
+  ASSERT_FALSE(schema.flags[0].present);
+  ASSERT_EQ_STR(levels[0], "warn");
+  ASSERT_TRUE(schema.next_command == NULL);
+
+  const OptlyResultCommand *app = first.commands;
+  ASSERT_TRUE(optly_result_has(app, "threads"));
+  ASSERT_EQ_INT(optly_result_value(app, "threads").as_uint32, 8);
+  ASSERT_EQ_STR(optly_result_value(app, "log").as_enum[0], "debug");
+  ASSERT_TRUE(app->next != NULL);
+  ASSERT_EQ_STR(app->next->command->name, "cp");
+  ASSERT_TRUE(optly_result_value(app->next, "force").as_bool);
+
+  const OptlyValues *src = optly_result_positional(app->next, "src");
+  const OptlyValues *dst = optly_result_positional(app->next, "dst");
+  ASSERT_EQ_INT(src->count, 1);
+  ASSERT_EQ_STR(src->items[0], "a");
+  ASSERT_EQ_INT(dst->count, 1);
+  ASSERT_EQ_STR(dst->items[0], "b");
+
+  app = second.commands;
+  ASSERT_FALSE(optly_result_has(app, "threads"));
+  ASSERT_EQ_INT(optly_result_value(app, "threads").as_uint32, 4);
+  ASSERT_EQ_STR(optly_result_value(app, "log").as_enum[0], "warn");
+  ASSERT_FALSE(optly_result_value(app->next, "force").as_bool);
+  ASSERT_EQ_STR(optly_result_positional(app->next, "src")->items[0], "x");
+  ASSERT_EQ_STR(optly_result_positional(app->next, "dst")->items[0], "y");
+}
+
+static void test_reentrant_parse_out_of_memory(void) {
+  const OptlyCommand schema = optly_command(
+    "app",
+    .flags = optly_flags(optly_flag_bool("verbose", .shortname = 'v'))
+  );
+
+  char        buf[8];
+  OptlyResult result = optly_result(buf, sizeof(buf));
+  char       *argv[] = ARGV("app", "-v");
+
+  ASSERT_FALSE(optly_parse(&schema, count_argc(argv), argv, &result));
+  assert_err_count(&result.errors, 1);
+  assert_err_at(&result.errors, 0, OPTLY_ERR_OUT_OF_MEMORY, "app");
+}
+
+static void test_parse_args_large_schema(void) {
+  // Parse state of 3000 flags doesn't fit OPTLY_PARSE_BUFFER_LENGTH, rest is grown
+  static OptlyFlag flags[3001];
+  static char      names[3000][16];
+
+  for (int i = 0; i < 3000; i++) {
+    snprintf(names[i], sizeof(names[i]), "f%d", i);
+    flags[i] = optly_flag_uint32(names[i], 0, "Flag");
+  }
+
+  flags[3000]      = (OptlyFlag)NULL_FLAG;
+  OptlyCommand cmd = optly_command("app", .flags = flags);
+  char        *argv[] = ARGV("app", "--f0=1", "--f2999=7");
+
+  ASSERT_TRUE(optly_result_size(&cmd) > OPTLY_PARSE_BUFFER_LENGTH);
+
+  OptlyErrors errs = optly_parse_args(count_argc(argv), argv, &cmd);
+  assert_err_count(&errs, 0);
+  ASSERT_EQ_INT(optly_flag_value_uint32(&cmd, "f0"), 1);
+  ASSERT_EQ_INT(optly_flag_value_uint32(&cmd, "f2999"), 7);
+
+  // Grown block is reused
+  char *again[] = ARGV("app", "--f1500=3");
+
+  errs = optly_parse_args(count_argc(again), again, &cmd);
+  assert_err_count(&errs, 0);
+  ASSERT_EQ_INT(optly_flag_value_uint32(&cmd, "f1500"), 3);
+}
+
+static void test_bound_flags_and_handles(void) {
+  char    *levels[] = {"warn", "debug", "warn", NULL};
+  uint32_t threads  = 4;
+  bool     verbose  = false;
+  char    *log      = NULL;
+  double   ratio    = 0.5;
+
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_uint32("threads", .shortname = 't', .bind.as_uint32 = &threads),
+      optly_flag_bool("verbose", .shortname = 'v', .bind.as_bool = &verbose),
+      optly_flag_enum("log", .shortname = 'l', .value.as_enum = levels, .bind.as_enum = &log),
+      optly_flag_double("ratio", .shortname = 'r', .bind.as_double = &ratio)
+    ),
+    .positionals = optly_positionals(optly_positional("file", .min = 0, .max = 1))
+  );
+
+  char       *argv[] = ARGV("app", "-v", "-t", "8", "--log=debug", "--ratio", "nope", "in.txt");
+  OptlyErrors errs   = optly_parse_args(count_argc(argv), argv, &cmd);
+
+  assert_err_count(&errs, 1);
+  assert_err_at(&errs, 0, OPTLY_ERR_INVALID_VALUE, "nope");
+
+  ASSERT_EQ_INT(threads, 8);
+  ASSERT_TRUE(verbose);
+  ASSERT_EQ_STR(log, "debug");
+  // NOTE: Invalid value is not written to bound variable
+  ASSERT_TRUE(ratio == 0.5);
+
+  OptlyHandle h_threads = optly_flag_handle(&cmd, "threads");
+  OptlyHandle h_file    = optly_positional_handle(&cmd, "file");
+
+  ASSERT_EQ_INT(h_threads, 0);
+  ASSERT_EQ_INT(h_file, 0);
+  ASSERT_TRUE(optly_flag_handle(&cmd, "missing") == OPTLY_NO_HANDLE);
+  ASSERT_TRUE(optly_positional_handle(&cmd, "missing") == OPTLY_NO_HANDLE);
+  ASSERT_EQ_INT(cmd.flags[h_threads].value.as_uint32, 8);
+
+  char        buf[1024];
+  OptlyResult res     = optly_result(buf, sizeof(buf));
+  char       *argv2[] = ARGV("app", "--threads=16", "out.txt");
+
+  ASSERT_TRUE(optly_parse(&cmd, count_argc(argv2), argv2, &res));
+  ASSERT_EQ_INT(threads, 16);
+  ASSERT_TRUE(optly_result_flag_present(res.commands, h_threads));
+  ASSERT_FALSE(optly_result_flag_present(res.commands, optly_flag_handle(&cmd, "verbose")));
+  ASSERT_EQ_INT(optly_result_flag(res.commands, h_threads).as_uint32, 16);
+  ASSERT_EQ_STR(optly_result_values(res.commands, h_file)->items[0], "out.txt");
+}
+
+static void test_parse_line(void) {
+  const OptlyCommand schema = optly_command(
+    "daemon",
+    .commands = optly_commands(
+      optly_command(
+        "deploy",
+        .flags       = optly_flags(optly_flag_uint32("replicas", .shortname = 'r')),
+        .positionals = optly_positionals(optly_positional("service", .min = 1, .max = 1))
+      )
+    )
+  );
+
+  char        buf[1024];
+  OptlyResult res    = optly_result(buf, sizeof(buf));
+  char       *argv[8];
+  char        line[] = "  deploy \"my service\"\t-r 3\n";
+
+  ASSERT_TRUE(optly_parse_line(&schema, line, argv, 8, &res));
+  ASSERT_EQ_STR(argv[0], "daemon");
+  ASSERT_TRUE(argv[5] == NULL);
+
+  const OptlyResultCommand *deploy = res.commands->next;
+  ASSERT_EQ_STR(deploy->command->name, "deploy");
+  ASSERT_EQ_INT(optly_result_value(deploy, "replicas").as_uint32, 3);
+  ASSERT_EQ_STR(optly_result_positional(deploy, "service")->items[0], "my service");
+
+  // Same result is reused for the next line
+  char empty[] = "   ";
+  ASSERT_TRUE(optly_parse_line(&schema, empty, argv, 8, &res));
+  ASSERT_TRUE(res.commands->next == NULL);
+
+  char long_line[] = "deploy a b c d e f g";
+  ASSERT_FALSE(optly_parse_line(&schema, long_line, argv, 4, &res));
+  assert_err_count(&res.errors, 1);
+  assert_err_at(&res.errors, 0, OPTLY_ERR_OUT_OF_MEMORY, "b c d e f g");
+
+  // Quote left open takes the rest of the line, so nothing is parsed
+  char open_quote[] = "deploy 'my service -r 3";
+  ASSERT_FALSE(optly_parse_line(&schema, open_quote, argv, 8, &res));
+  assert_err_count(&res.errors, 1);
+  assert_err_at(&res.errors, 0, OPTLY_ERR_UNCLOSED_QUOTE, "my service -r 3");
+  ASSERT_TRUE(res.commands == NULL);
+}
+
+static void test_push_parser(void) {
+  const OptlyCommand schema = optly_command(
+    "app",
+    .flags    = optly_flags(optly_flag_uint32("threads", .shortname = 't')),
+    .commands = optly_commands(
+      optly_command(
+        "cp",
+        .flags       = optly_flags(optly_flag_bool("force", .shortname = 'f')),
+        .positionals = optly_positionals(
+          optly_positional("src", .min = 1, .max = 0),
+          optly_positional("dst", .min = 1, .max = 1)
+        )
+      )
+    )
+  );
+
+  char        buf[1024];
+  OptlyResult res = optly_result(buf, sizeof(buf));
+  OptlyParser parser;
+
+  optly_parser_init(&parser, &schema, &res);
+
+  // Flag value comes in the next token
+  ASSERT_TRUE(optly_parser_feed(&parser, "--threads"));
+  ASSERT_TRUE(parser.pending != NULL);
+  ASSERT_TRUE(optly_parser_feed(&parser, "8"));
+  ASSERT_TRUE(parser.pending == NULL);
+  ASSERT_EQ_INT(optly_result_value(res.commands, "threads").as_uint32, 8);
+
+  ASSERT_TRUE(optly_parser_feed(&parser, "cp"));
+  ASSERT_EQ_STR(parser.level->command->name, "cp");
+
+  // Unknown flag is reported right away
+  ASSERT_FALSE(optly_parser_feed(&parser, "--nope"));
+  assert_err_count(&res.errors, 1);
+  assert_err_at(&res.errors, 0, OPTLY_ERR_UNKNOWN_FLAG, "--nope");
+
+  ASSERT_TRUE(optly_parser_feed(&parser, "-f"));
+  ASSERT_TRUE(optly_parser_feed(&parser, "a"));
+  ASSERT_TRUE(optly_parser_feed(&parser, "--"));
+  ASSERT_TRUE(optly_parser_feed(&parser, "-b"));
+  ASSERT_TRUE(optly_parser_feed(&parser, "c"));
+
+  ASSERT_FALSE(optly_parser_finish(&parser));
+  assert_err_count(&res.errors, 1);
+
+  const OptlyResultCommand *cp = res.commands->next;
+  ASSERT_TRUE(optly_result_value(cp, "force").as_bool);
+  ASSERT_EQ_INT(optly_result_positional(cp, "src")->count, 2);
+  ASSERT_EQ_STR(optly_result_positional(cp, "src")->items[1], "-b");
+  ASSERT_EQ_STR(optly_result_positional(cp, "dst")->items[0], "c");
+
+  // Flag still waiting for value when input ends
+  optly_parser_init(&parser, &schema, &res);
+  ASSERT_TRUE(optly_parser_feed(&parser, "-t"));
+  ASSERT_FALSE(optly_parser_finish(&parser));
+  assert_err_count(&res.errors, 1);
+  assert_err_at(&res.errors, 0, OPTLY_ERR_MISSING_VALUE, "threads");
+}
+
+static void write_temp(char *path, const char *content, size_t size) {
+  int fd = mkstemp(path);
+  ASSERT_TRUE(fd >= 0);
+  ASSERT_TRUE(write(fd, content, size) == (ssize_t)size);
+  close(fd);
+}
+
+static void test_response_files(void) {
+  char nested[] = "/tmp/optly-nested-XXXXXX";
+  char outer[]  = "/tmp/optly-outer-XXXXXX";
+  char text[256];
+
+  write_temp(nested, "-v\nlast", 8);
+  snprintf(text, sizeof(text), "--threads 8 \"hello world\" 'a\\b' c\\ d \"\" @%s", nested);
+  write_temp(outer, text, strlen(text));
+
+  OptlyCommand cmd = optly_command(
+    "app",
+    .flags = optly_flags(
+      optly_flag_uint32("threads", .shortname = 't'),
+      optly_flag_bool("verbose", .shortname = 'v')
+    ),
+    .positionals = optly_positionals(optly_positional("files", .min = 1, .max = 0))
+  );
+
+  char  arg[64];
+  char *at_literal = "@literal";
+  snprintf(arg, sizeof(arg), "@%s", outer);
+
+  char *argv[] = {"app", "first", arg, "--", at_literal, NULL};
+  int   argc   = 5;
+
+  OptlyErrors        errs  = {0};
+  OptlyResponseFiles files = {0};
+
+  char **expanded = argv;
+
+  ASSERT_TRUE(optly_expand_response_files(&argc, &expanded, &files, &errs));
+  ASSERT_EQ_INT(files.count, 2);
+  ASSERT_TRUE(expanded == files.argv);
+  ASSERT_EQ_INT(argc, 12);
+  ASSERT_EQ_STR(expanded[1], "first");
+  ASSERT_EQ_STR(expanded[2], "--threads");
+  ASSERT_EQ_STR(expanded[4], "hello world");
+  ASSERT_EQ_STR(expanded[5], "a\\b");
+  ASSERT_EQ_STR(expanded[6], "c d");
+  ASSERT_EQ_STR(expanded[7], "");
+  ASSERT_EQ_STR(expanded[8], "-v");
+  ASSERT_EQ_STR(expanded[9], "last");
+  // Nothing after '--' is expanded
+  ASSERT_EQ_STR(expanded[11], "@literal");
+  ASSERT_TRUE(expanded[12] == NULL);
+
+  char        buf[1024];
+  OptlyResult res = optly_result(buf, sizeof(buf));
+
+  ASSERT_TRUE(optly_parse(&cmd, argc, expanded, &res));
+  ASSERT_EQ_INT(optly_result_value(res.commands, "threads").as_uint32, 8);
+  ASSERT_TRUE(optly_result_value(res.commands, "verbose").as_bool);
+  ASSERT_EQ_INT(optly_result_positional(res.commands, "files")->count, 7);
+
+  optly_response_files_free(&files);
+
+  // Legacy parse expands by itself, file that fills whole page still gets terminated
+  char page[] = "/tmp/optly-page-XXXXXX";
+  char full[4096];
+  memset(full, 'x', sizeof(full));
+  full[0] = '-';
+  full[1] = 'v';
+  full[2] = ' ';
+  write_temp(page, full, sizeof(full));
+
+  snprintf(arg, sizeof(arg), "@%s", page);
+  char *argv2[] = {"app", arg, "@/nonexistent/optly", NULL};
+
+  errs = optly_parse_args(3, argv2, &cmd);
+  assert_err_count(&errs, 1);
+  assert_err_at(&errs, 0, OPTLY_ERR_RESPONSE_FILE, "/nonexistent/optly");
+  ASSERT_TRUE(optly_flag_value_bool(&cmd, "verbose"));
+
+  OptlyPositional *files_pos = optly_get_positional(&cmd, "files");
+  ASSERT_EQ_INT(files_pos->count, 1);
+  ASSERT_EQ_INT(strlen(files_pos->values[0]), sizeof(full) - 3);
+
+  // Quote left open in file is reported with its path
+  char open_quote[] = "/tmp/optly-quote-XXXXXX";
+  write_temp(open_quote, "-v \"last", 8);
+
+  snprintf(arg, sizeof(arg), "@%s", open_quote);
+  char *argv4[] = {"app", arg, NULL};
+  argc          = 2;
+  expanded      = argv4;
+  errs          = (OptlyErrors){0};
+  files         = (OptlyResponseFiles){0};
+
+  ASSERT_FALSE(optly_expand_response_files(&argc, &expanded, &files, &errs));
+  assert_err_count(&errs, 1);
+  assert_err_at(&errs, 0, OPTLY_ERR_UNCLOSED_QUOTE, NULL);
+  ASSERT_EQ_STR(optly_errors_at(&errs, 0).arg, open_quote);
+  optly_response_files_free(&files);
+  unlink(open_quote);
+
+  // File including itself stops at depth limit with its own error
+  char self[] = "/tmp/optly-self-XXXXXX";
+  int  fd     = mkstemp(self);
+  ASSERT_TRUE(fd >= 0);
+  snprintf(text, sizeof(text), "-v @%s", self);
+  ASSERT_TRUE(write(fd, text, strlen(text)) == (ssize_t)strlen(text));
+  close(fd);
+
+  snprintf(arg, sizeof(arg), "@%s", self);
+  char *argv3[] = {"app", arg, NULL};
+  argc          = 2;
+  expanded      = argv3;
+  errs          = (OptlyErrors){0};
+  files         = (OptlyResponseFiles){0};
+
+  ASSERT_FALSE(optly_expand_response_files(&argc, &expanded, &files, &errs));
+  assert_err_count(&errs, 1);
+  assert_err_at(&errs, 0, OPTLY_ERR_RESPONSE_FILE_DEPTH, NULL);
+  ASSERT_EQ_STR(optly_errors_at(&errs, 0).arg, self);
+  ASSERT_EQ_INT(argc, 1 + OPTLY_RESPONSE_FILE_DEPTH);
+  optly_response_files_free(&files);
+
+  unlink(self);
+  unlink(nested);
+  unlink(outer);
+  unlink(page);
+}
+
 int main(void) {
   fprintf(stderr, "\nRunning optly tests...\n\n");
 
   RUN_TEST(test_optional_flags_defaults);
   RUN_TEST(test_long_short_and_batch_bools);
+  RUN_TEST(test_packed_bools);
+  RUN_TEST(test_token_forms);
+  RUN_TEST(test_long_names_without_copy);
+  RUN_TEST(test_usage_to_buffer);
   RUN_TEST(test_inline_and_separate_values);
   RUN_TEST(test_short_value_equals_and_space);
   RUN_TEST(test_typed_values);
+  RUN_TEST(test_number_formats_and_ranges);
+  RUN_TEST(test_unit_types);
+  RUN_TEST(test_custom_converter);
+  RUN_TEST(test_list_flags);
+  RUN_TEST(test_constraint_groups);
   RUN_TEST(test_commands_and_command_flags);
   RUN_TEST(test_subcommand_selection);
   RUN_TEST(test_positionals_and_delimiter);
+  RUN_TEST(test_positionals_distribution);
+  RUN_TEST(test_positionals_unbounded);
+  RUN_TEST(test_positionals_typed);
+  RUN_TEST(test_positionals_streaming);
+  RUN_TEST(test_parse_line);
+  RUN_TEST(test_push_parser);
+  RUN_TEST(test_response_files);
   RUN_TEST(test_error_unknown_flag_missing_invalid);
   RUN_TEST(test_error_unknown_command);
   RUN_TEST(test_error_required_and_batch_non_bool);
@@ -452,6 +2234,18 @@ int main(void) {
   RUN_TEST(test_enum_errors);
   RUN_TEST(test_enum_short_and_overwrite);
   RUN_TEST(test_enum_mixed_with_other_flags);
+  RUN_TEST(test_enum_index);
+  RUN_TEST(test_compiled_index_matches_scan);
+  RUN_TEST(test_generated_index);
+  RUN_TEST(test_generate_ident_collision);
+  RUN_TEST(test_compile_out_of_memory);
+  RUN_TEST(test_lazy_command_provider);
+  RUN_TEST(test_reentrant_parse_keeps_schema_intact);
+  RUN_TEST(test_read_only_schema);
+  RUN_TEST(test_parse_batch);
+  RUN_TEST(test_reentrant_parse_out_of_memory);
+  RUN_TEST(test_parse_args_large_schema);
+  RUN_TEST(test_bound_flags_and_handles);
 
   fprintf(stderr, "\nAsserts: %d\n", g_asserts);
 
@@ -0,0 +1,18 @@
+// Emits static lookup code for a schema, see gen.sh.
+//
+//   cc -I. -DOPTLY_GEN_SCHEMA='"schema.h"' -DOPTLY_GEN_COMMAND=app -o optly_gen tools/optly_gen.c
+//   ./optly_gen app > app_gen.h
+//
+// Schema header is included first, so defines it makes (OPTLY_GEN_HELP_FLAG and
+// such) apply to usage that is rendered here.
+
+#include OPTLY_GEN_SCHEMA
+
+#define OPTLY_IMPLEMENTATION
+#define OPTLY_GENERATOR
+#include <optly.h>
+
+int main(int argc, char **argv) {
+  const char *prefix = argc > 1 ? argv[1] : "optly_gen";
+  return optly_generate(&OPTLY_GEN_COMMAND, prefix, stdout) ? 0 : 1;
+}